@@ -1,4 +1,8 @@
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 class Cell final {
     public:
@@ -10,19 +14,25 @@ class Cell final {
 };
 
 
+enum class PieceKind: unsigned char { King, Bishop, Rook, Queen };
+
 class Piece {
+    private:
+        PieceKind tag;                                       // set once by the subclass, so batch queries need no virtual calls
+
     public:
         Cell cell;
 
-        Piece(Cell c): cell(c) {};
-        Piece(): Piece(Cell('A', 1)) {};
+        Piece(Cell c, PieceKind kind): tag(kind), cell(c) {};
+        Piece(PieceKind kind): Piece(Cell('A', 1), kind) {};
 
         virtual bool available(Cell c) const = 0;
+        PieceKind kind() const { return tag; }
 };
 
 class King: public Piece {
     public:
-        King(Cell c): Piece(c) {};
+        King(Cell c): Piece(c, PieceKind::King) {};
         King(): King(Cell('A', 1)) {};
 
         bool available(Cell c) const override {
@@ -34,7 +44,7 @@ class King: public Piece {
 
 class Bishop: public Piece {
     public:
-        Bishop(Cell c): Piece(c) {};
+        Bishop(Cell c): Piece(c, PieceKind::Bishop) {};
         Bishop(): Bishop(Cell('A', 1)) {};
 
         bool available(Cell c) const override {
@@ -46,7 +56,7 @@ class Bishop: public Piece {
 
 class Rook: public Piece {
     public:
-        Rook(Cell c): Piece(c) {};
+        Rook(Cell c): Piece(c, PieceKind::Rook) {};
         Rook(): Rook(Cell('A', 1)) {};
 
         bool available(Cell c) const override {
@@ -58,7 +68,7 @@ class Rook: public Piece {
 
 class Queen: public Piece {
     public:
-        Queen(Cell c): Piece(c) {};
+        Queen(Cell c): Piece(c, PieceKind::Queen) {};
         Queen(): Queen(Cell('A', 1)) {};
 
         bool available(Cell c) const override {
@@ -68,11 +78,282 @@ class Queen: public Piece {
         }
 };
 
+/**
+ * Cells of the board as bits of a 64-bit mask, bit (h - 1) * 8 + (v - 'A') stands for the cell (v, h).
+ * Attacks of every piece kind from every cell are precomputed once. Sliding pieces stop at the first occupied cell,
+ * their attacks are found in tables indexed by magic multiplication of the occupied cells on their rays.
+ * With an empty board the masks are exactly the cells accepted by Piece::available.
+*/
+class Bitboards final {
+    private:
+        struct Magic {
+            uint64_t mask;          // cells whose occupancy matters, board edges excluded
+            uint64_t magic;
+            unsigned shift;
+            std::size_t offset;     // first entry of the square in table
+        };
+
+        static constexpr int rook_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        static constexpr int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+        uint64_t king[64];
+        Magic rook[64];
+        Magic bishop[64];
+        std::vector<uint64_t> table;
+
+        static uint64_t slide(unsigned square, uint64_t occupancy, int const (&directions)[4][2], bool edges) {
+            uint64_t result = 0;
+            for (auto const &direction : directions) {
+                int v = square % 8 + direction[0], h = square / 8 + direction[1];
+                for (; v >= 0 && v < 8 && h >= 0 && h < 8; v += direction[0], h += direction[1]) {
+                    int next_v = v + direction[0], next_h = h + direction[1];
+                    if (!edges && (next_v < 0 || next_v > 7 || next_h < 0 || next_h > 7))
+                        break;
+                    result |= 1ULL << (h * 8 + v);
+                    if (occupancy >> (h * 8 + v) & 1)
+                        break;
+                }
+            }
+            return result;
+        }
+
+        void init_magics(Magic (&magics)[64], int const (&directions)[4][2]) {
+            // seeds for every rank that are known to find magics after few attempts
+            const uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+
+            std::vector<uint64_t> occupancies, attacks, used;
+            for (unsigned square = 0; square < 64; square++) {
+                Magic &m = magics[square];
+                m.mask = slide(square, 0, directions, false);
+                m.shift = 64 - __builtin_popcountll(m.mask);
+                m.offset = table.size();
+
+                // all subsets of the mask, enumerated by the carry-rippler trick
+                occupancies.clear();
+                attacks.clear();
+                uint64_t subset = 0;
+                do {
+                    occupancies.push_back(subset);
+                    attacks.push_back(slide(square, subset, directions, true));
+                    subset = (subset - m.mask) & m.mask;
+                } while (subset);
+
+                std::size_t size = occupancies.size();
+                table.resize(m.offset + size);
+                used.assign(size, 0);
+                uint64_t seed = seeds[square / 8];
+                for (uint64_t attempt = 1;; attempt++) {
+                    // sparse candidates are the most likely to be magic
+                    m.magic = next_random(seed) & next_random(seed) & next_random(seed);
+                    if (__builtin_popcountll((m.mask * m.magic) >> 56) < 6)
+                        continue;
+
+                    bool collision = false;
+                    for (std::size_t idx = 0; idx < size && !collision; idx++) {
+                        std::size_t key = (occupancies[idx] * m.magic) >> m.shift;
+                        if (used[key] != attempt) {
+                            used[key] = attempt;
+                            table[m.offset + key] = attacks[idx];
+                        } else
+                            collision = table[m.offset + key] != attacks[idx];
+                    }
+                    if (!collision)
+                        break;
+                }
+            }
+        }
+
+        static uint64_t next_random(uint64_t &seed) {
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            return seed * 2685821657736338717ULL;
+        }
+
+        uint64_t lookup(Magic const &m, uint64_t occupancy) const {
+            return table[m.offset + (((occupancy & m.mask) * m.magic) >> m.shift)];
+        }
+
+        Bitboards() {
+            for (unsigned square = 0; square < 64; square++) {
+                king[square] = 0;
+                for (int dv = -1; dv <= 1; dv++)
+                    for (int dh = -1; dh <= 1; dh++) {
+                        int v = square % 8 + dv, h = square / 8 + dh;
+                        if ((dv || dh) && v >= 0 && v < 8 && h >= 0 && h < 8)
+                            king[square] |= 1ULL << (h * 8 + v);
+                    }
+            }
+
+            init_magics(rook, rook_directions);
+            init_magics(bishop, bishop_directions);
+        }
+
+    public:
+        Bitboards(Bitboards const &) = delete;
+        Bitboards& operator =(Bitboards const &) = delete;
+
+        static Bitboards const& instance() {
+            static Bitboards const bitboards;
+            return bitboards;
+        }
+
+        static unsigned square(Cell c) {
+            return (c.h - 1) * 8 + (c.v - 'A');
+        }
+
+        static Cell cell(unsigned square) {
+            return Cell('A' + square % 8, square / 8 + 1);
+        }
+
+        /**
+         * @param kind kind of the piece.
+         * @param square cell of the piece.
+         * @param occupancy occupied cells, sliding pieces can move onto the first of them on every ray.
+         * @return cells available to the piece.
+        */
+        uint64_t attacks(PieceKind kind, unsigned square, uint64_t occupancy = 0) const {
+            switch (kind) {
+                case PieceKind::King:   return king[square];
+                case PieceKind::Bishop: return lookup(bishop[square], occupancy);
+                case PieceKind::Rook:   return lookup(rook[square], occupancy);
+                case PieceKind::Queen:  return lookup(bishop[square], occupancy) | lookup(rook[square], occupancy);
+            }
+            return 0;
+        }
+};
+
+constexpr int Bitboards::rook_directions[4][2];
+constexpr int Bitboards::bishop_directions[4][2];
+
+/**
+ * Set of pieces standing on one board.
+*/
+struct Position {
+    const Piece **pieces;
+    std::size_t pieces_count;
+};
+
+/**
+ * Finds all cells available to every piece at once.
+ *
+ * @param cells receives the mask of available cells of every piece.
+ * @param blocked whether the pieces block the rays of each other; without it the board is treated as empty
+ * like in Piece::available.
+ * @return cells available to at least one piece.
+*/
+uint64_t available_cells(Position const &position, uint64_t *cells, bool blocked = false) {
+    Bitboards const &bitboards = Bitboards::instance();
+    uint64_t occupancy = 0;
+    if (blocked)
+        for (std::size_t piece_idx = 0; piece_idx != position.pieces_count; ++piece_idx)
+            occupancy |= 1ULL << Bitboards::square(position.pieces[piece_idx]->cell);
+
+    uint64_t any = 0;
+    for (std::size_t piece_idx = 0; piece_idx != position.pieces_count; ++piece_idx) {
+        const Piece *piece = position.pieces[piece_idx];
+        cells[piece_idx] = bitboards.attacks(piece->kind(), Bitboards::square(piece->cell), occupancy);
+        any |= cells[piece_idx];
+    }
+    return any;
+}
+
+/**
+ * Batch query over many positions, cells[i] receives the cells available to at least one piece of positions[i].
+*/
+void available_cells(Position const *positions, uint64_t *cells, std::size_t positions_count, bool blocked = false) {
+    std::vector<uint64_t> piece_cells;
+    for (std::size_t position_idx = 0; position_idx != positions_count; ++position_idx) {
+        piece_cells.resize(positions[position_idx].pieces_count);
+        cells[position_idx] = available_cells(positions[position_idx], piece_cells.data(), blocked);
+    }
+}
+
 void are_available(Cell c, const Piece **pieces, bool *availability, std::size_t pieces_count) {
-    for (std::size_t piece_idx = 0; piece_idx != pieces_count; ++piece_idx)
-        availability[piece_idx] = pieces[piece_idx]->available(c);
+    Bitboards const &bitboards = Bitboards::instance();
+    unsigned target = Bitboards::square(c);
+    for (std::size_t piece_idx = 0; piece_idx != pieces_count; ++piece_idx) {
+        const Piece *piece = pieces[piece_idx];
+        availability[piece_idx] = bitboards.attacks(piece->kind(), Bitboards::square(piece->cell)) >> target & 1;
+    }
 }
 
+/**
+ * Pieces stored as a structure of arrays: kind, file (0 for 'A') and rank (0 for 1) of every piece in its own array.
+ * Availability is evaluated by the same formulas as Piece::available, but without branches, for all pieces of a
+ * kind mix at once, so the loops vectorize. Results are packed bitmasks: bit i of word i / 64 stands for piece i.
+*/
+class PieceSet final {
+    private:
+        // pieces are evaluated in blocks of one mask word
+        static constexpr std::size_t block = 64;
+
+        std::vector<unsigned char> kinds;
+        std::vector<unsigned char> files;
+        std::vector<unsigned char> ranks;
+
+        void available_block(int v, int h, std::size_t first, std::size_t count, uint64_t &mask) const {
+            unsigned char const *kind = kinds.data() + first;
+            unsigned char const *file = files.data() + first;
+            unsigned char const *rank = ranks.data() + first;
+            unsigned char result[block];
+
+            for (std::size_t idx = 0; idx < count; idx++) {
+                int dv = file[idx] - v, dh = rank[idx] - h;
+                dv = dv < 0 ? -dv : dv;
+                dh = dh < 0 ? -dh : dh;
+
+                int king = (dv < 2) & (dh < 2);
+                int line = (dv == 0) | (dh == 0);
+                int diagonal = dv == dh;
+                int k = kind[idx];
+                int moves = (king & (k == (int)PieceKind::King))
+                          | (diagonal & ((k == (int)PieceKind::Bishop) | (k == (int)PieceKind::Queen)))
+                          | (line & ((k == (int)PieceKind::Rook) | (k == (int)PieceKind::Queen)));
+                result[idx] = moves & ((dv | dh) != 0);
+            }
+
+            uint64_t packed = 0;
+            for (std::size_t idx = 0; idx < count; idx++)
+                packed |= (uint64_t)result[idx] << idx;
+            mask = packed;
+        }
+
+    public:
+        void add(PieceKind kind, Cell c) {
+            kinds.push_back((unsigned char)kind);
+            files.push_back(c.v - 'A');
+            ranks.push_back(c.h - 1);
+        }
+
+        void add(Piece const &piece) {
+            add(piece.kind(), piece.cell);
+        }
+
+        std::size_t size() const { return kinds.size(); }
+
+        // number of mask words for one cell
+        std::size_t words() const { return (size() + block - 1) / block; }
+
+        /**
+         * @param c target cell.
+         * @param mask receives words() words, bit i is set if piece i can move to c.
+        */
+        void available(Cell c, uint64_t *mask) const {
+            for (std::size_t first = 0, word = 0; first < size(); first += block, word++)
+                available_block(c.v - 'A', c.h - 1, first, std::min(block, size() - first), mask[word]);
+        }
+
+        /**
+         * @param cells target cells.
+         * @param masks receives words() words for every cell one after another.
+        */
+        void available(Cell const *cells, std::size_t cells_count, uint64_t *masks) const {
+            for (std::size_t cell_idx = 0; cell_idx != cells_count; ++cell_idx)
+                available(cells[cell_idx], masks + cell_idx * words());
+        }
+};
+
 int main() {
         const std::size_t size = 4;
         const Piece * pieces[size];
@@ -87,6 +368,22 @@ int main() {
         for(auto ans : availability)
             std::cout << ans << ' ';
         std::cout << std::endl;
+
+        uint64_t cells[size];
+        uint64_t any = available_cells(Position{pieces, size}, cells, true);
+        for (unsigned square = 0; square < 64; square++)
+            if (any >> square & 1)
+                std::cout << Bitboards::cell(square).v << Bitboards::cell(square).h << ' ';
+        std::cout << std::endl;
+
+        PieceSet set;
+        for (auto p : pieces)
+            set.add(*p);
+        uint64_t mask;
+        set.available(Cell('A', 1), &mask);
+        for (std::size_t piece_idx = 0; piece_idx != size; ++piece_idx)
+            std::cout << (mask >> piece_idx & 1) << ' ';
+        std::cout << std::endl;
     
         for (auto p : pieces)
             delete p;
@@ -1,13 +1,27 @@
 #include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+#include <vector>
 
 struct RealFunction {
     virtual double operator()(unsigned idx) const = 0;
+
+    /**
+     * Evaluates the function at every idx of [begin, end) into values[idx - begin].
+     * Override it when a range is cheaper to evaluate than separate points.
+    */
+    virtual void operator()(unsigned begin, unsigned end, double *values) const {
+        for (unsigned idx = begin; idx < end; idx++)
+            values[idx - begin] = (*this)(idx);
+    }
 };
 
 unsigned max_at(unsigned begin, unsigned end, RealFunction const &f);
-        
+
 double derivative(unsigned at, RealFunction const &f);
-        
+
 struct DerivativeFunction: public RealFunction {
     RealFunction const &f;
 
@@ -16,12 +30,108 @@ struct DerivativeFunction: public RealFunction {
     double operator()(unsigned idx) const override{
         return derivative(idx, f);
     }
+
+    // Samples f once per point into values and takes differences in place, f(end - 1) and f(end) are the only extra samples.
+    void operator()(unsigned begin, unsigned end, double *values) const override{
+        if (begin == end)
+            return;
+        if (begin == 0) {
+            values[0] = derivative(0, f);
+            (*this)(1, end, values + 1);
+            return;
+        }
+
+        unsigned count = end - begin;
+        f(begin - 1, end - 1, values);
+        double before_last = f(end - 1), last = f(end);
+        for (unsigned idx = 0; idx + 2 < count; idx++)
+            values[idx] = (values[idx + 2] - values[idx]) / 2;
+        if (count > 1)
+            values[count - 2] = (before_last - values[count - 2]) / 2;
+        values[count - 1] = (last - values[count - 1]) / 2;
+    }
+};
+
+/**
+ * Central difference, forward difference at 0.
+*/
+double derivative(unsigned at, RealFunction const &f) {
+    if (at == 0)
+        return f(1) - f(0);
+    return (f(at + 1) - f(at - 1)) / 2;
+}
+
+// number of points evaluated by one batch call
+const unsigned max_block = 4096;
+const unsigned parallel_threshold = 1 << 16;
+
+/**
+ * First maximum of f on [begin, end) for one thread. Points are evaluated in blocks, and every block is scanned
+ * twice: for the maximal value and then for its first position, both loops vectorize.
+*/
+void max_at_range(unsigned begin, unsigned end, RealFunction const &f, unsigned &at, double &value) {
+    double values[max_block];
+    at = begin;
+    value = -INFINITY;
+    for (unsigned first = begin; first < end; first += max_block) {
+        unsigned count = std::min(max_block, end - first);
+        f(first, first + count, values);
+
+        double best = values[0];
+        for (unsigned idx = 1; idx < count; idx++)
+            best = values[idx] > best ? values[idx] : best;
+        if (!(best > value))
+            continue;
+
+        unsigned idx = 0;
+        while (values[idx] != best)
+            idx++;
+        at = first + idx;
+        value = best;
+    }
+}
+
+/**
+ * Index of the first maximum of f on [begin, end). Long ranges are split between threads.
+*/
+unsigned max_at(unsigned begin, unsigned end, RealFunction const &f) {
+    assert(begin < end);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (end - begin < parallel_threshold)
+        threads = 1;
+
+    std::vector<unsigned> at(threads);
+    std::vector<double> value(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++) {
+        unsigned first = begin + (unsigned long long)(end - begin) * t / threads;
+        unsigned last = begin + (unsigned long long)(end - begin) * (t + 1) / threads;
+        workers.emplace_back(max_at_range, first, last, std::cref(f), std::ref(at[t]), std::ref(value[t]));
+    }
+    max_at_range(begin, begin + (end - begin) / threads, f, at[0], value[0]);
+    for (auto &worker : workers)
+        worker.join();
+
+    // ranges go in order, so a strict comparison keeps the first maximum
+    unsigned result = 0;
+    for (unsigned t = 1; t < threads; t++)
+        if (value[t] > value[result])
+            result = t;
+    return at[result];
+}
+
+struct SimpleFunction: public RealFunction {
+    using RealFunction::operator();
+
+    double operator()(unsigned idx) const override{
+        return std::sin(idx * 0.01) * idx;
+    }
 };
 
-// int main() {
-//     SimpleFunction f;
-//     RealFunction const &rf = f;
-//     DerivativeFunction g(rf);
-//     std::cout << max_at(1, 1024, g);
-//     return 0;
-// }
\ No newline at end of file
+int main() {
+    SimpleFunction f;
+    RealFunction const &rf = f;
+    DerivativeFunction g(rf);
+    std::cout << max_at(1, 1024, g);
+    return 0;
+}
@@ -1,4 +1,17 @@
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 struct Point {
     unsigned long long const x, y;
@@ -45,68 +58,422 @@ struct Rectangle: Point {
     }
 };
 
-Rectangle processed_string(std::string expression){
-    std::string coordinates[6];
-    bool bracket = false;
-    bool plus = false;
-    bool multi = false;
+/**
+ * Value of a piece of an expression cut between points. head is the product before the first '+', sum holds the
+ * finished terms and tail is the product after the last '+'. Without '+' the whole piece is one product kept in head.
+ * Pieces combine associatively, so a long expression can be cut at any operator and reduced as a tree.
+*/
+struct PartialSum {
+    // (0, 0) is neutral for '+', so an empty sum needs no flag
+    unsigned long long head_x = 0, head_y = 0;
+    unsigned long long sum_x = 0, sum_y = 0;
+    unsigned long long tail_x = 0, tail_y = 0;
+    bool split = false;
+};
+
+void add_to(unsigned long long &x, unsigned long long &y, unsigned long long rha_x, unsigned long long rha_y) {
+    Rectangle sum = Rectangle(Point(x, y)) + Point(rha_x, rha_y);
+    x = sum.x;
+    y = sum.y;
+}
+
+void multiply_to(unsigned long long &x, unsigned long long &y, unsigned long long rha_x, unsigned long long rha_y) {
+    Rectangle product = Rectangle(Point(x, y)) * Point(rha_x, rha_y);
+    x = product.x;
+    y = product.y;
+}
+
+/**
+ * Joins two adjacent pieces of an expression that were separated by the operator op.
+*/
+PartialSum combine(PartialSum const &lha, char op, PartialSum const &rha) {
+    PartialSum result;
+    result.split = lha.split || rha.split || op == '+';
+    result.head_x = lha.head_x;
+    result.head_y = lha.head_y;
+    result.tail_x = rha.split ? rha.tail_x : rha.head_x;
+    result.tail_y = rha.split ? rha.tail_y : rha.head_y;
+
+    // the products that meet at the cut
+    unsigned long long left_x = lha.split ? lha.tail_x : lha.head_x, left_y = lha.split ? lha.tail_y : lha.head_y;
+    unsigned long long right_x = rha.head_x, right_y = rha.head_y;
+
+    if (lha.split)
+        add_to(result.sum_x, result.sum_y, lha.sum_x, lha.sum_y);
+    if (op == '+') {
+        if (lha.split)
+            add_to(result.sum_x, result.sum_y, left_x, left_y);
+        if (rha.split)
+            add_to(result.sum_x, result.sum_y, right_x, right_y);
+    } else {
+        multiply_to(left_x, left_y, right_x, right_y);
+        if (!lha.split) {
+            result.head_x = left_x;
+            result.head_y = left_y;
+        }
+        if (!rha.split) {
+            result.tail_x = left_x;
+            result.tail_y = left_y;
+        } else if (lha.split)
+            add_to(result.sum_x, result.sum_y, left_x, left_y);
+    }
+    if (rha.split)
+        add_to(result.sum_x, result.sum_y, rha.sum_x, rha.sum_y);
+    return result;
+}
+
+Rectangle value(PartialSum const &partial) {
+    if (!partial.split)
+        return Rectangle(Point(partial.head_x, partial.head_y));
+    unsigned long long x = partial.head_x, y = partial.head_y;
+    add_to(x, y, partial.sum_x, partial.sum_y);
+    add_to(x, y, partial.tail_x, partial.tail_y);
+    return Rectangle(Point(x, y));
+}
+
+/**
+ * Single pass evaluator of expressions like (1, 2) + (3, 4) * (5, 6).
+ * Numbers are parsed straight into integers. '*' binds tighter than '+' and there is no grouping, so the operator
+ * stack never holds more than the pending sum and the pending product, both kept as plain coordinates.
+ * Input may be fed in chunks of any size, a point may be split between chunks.
+*/
+class ExpressionEvaluator {
+private:
+    PartialSum partial;
+    unsigned long long product_x = 0, product_y = 0;
+    unsigned long long coordinates[2] = {0, 0};
     int shift = 0;
-    expression += '+';
-
-    for (char c:expression){
-        if (c == ' ')
-            continue;
-
-        if (c == '(')
-            bracket = true;
-        else if (c == ',')
-            shift += 1;
-        else if (c == ')'){
-            bracket = false;
-            shift += 1;
+    bool digits = false;    // current coordinate has at least one digit
+    bool bracket = false;
+    bool has_product = false;
+    bool pending_multiply = false;
+
+    void push_point() {
+        if (shift != 1 || !digits)
+            throw std::invalid_argument("point must have two coordinates");
+        Point point(coordinates[0], coordinates[1]);
+        if (has_product && !pending_multiply)
+            throw std::invalid_argument("missing operator between points");
+
+        if (has_product)
+            multiply_to(product_x, product_y, point.x, point.y);
+        else {
+            product_x = point.x;
+            product_y = point.y;
         }
-        else if (c == '*' || c == '+'){
-            if (multi){
-                Rectangle r1(Point(std::stoull(coordinates[shift-4]), std::stoull(coordinates[shift-3])));
-                Rectangle r2(Point(std::stoull(coordinates[shift-2]), std::stoull(coordinates[shift-1])));
-                Rectangle r3 = r1 * r2;
-                coordinates[shift-4] = std::to_string(r3.x);
-                coordinates[shift-3] = std::to_string(r3.y);
-                coordinates[shift-2] = "";
-                coordinates[shift-1] = "";
-                shift -= 2;
-                multi = false;
+        has_product = true;
+        pending_multiply = false;
+        coordinates[0] = coordinates[1] = 0;
+        shift = 0;
+        digits = false;
+    }
+
+    void push_operator(char c) {
+        if (!has_product || pending_multiply)
+            throw std::invalid_argument(std::string("missing point before '") + c + '\'');
+
+        if (c == '*') {
+            pending_multiply = true;
+            return;
+        }
+        if (!partial.split) {
+            partial.head_x = product_x;
+            partial.head_y = product_y;
+            partial.split = true;
+        } else
+            add_to(partial.sum_x, partial.sum_y, product_x, product_y);
+        has_product = false;
+    }
+
+public:
+    /**
+     * Consumes characters until the end of the chunk or the end of the line.
+     *
+     * @return pointer to the '\n' that ends the expression, or end if the expression continues in the next chunk.
+    */
+    char const* feed(char const* begin, char const* end) {
+        for (char const* it = begin; it != end; it++) {
+            char c = *it;
+            if (c >= '0' && c <= '9') {
+                if (!bracket)
+                    throw std::invalid_argument("number outside of a point");
+                unsigned long long &value = coordinates[shift];
+                unsigned digit = c - '0';
+                if (value > (~0ULL - digit) / 10)
+                    throw std::out_of_range("coordinate is too big");
+                value = value * 10 + digit;
+                digits = true;
             }
-            if (c == '+' && plus) {
-                Rectangle r1(Point(std::stoull(coordinates[shift-4]), std::stoull(coordinates[shift-3])));
-                Rectangle r2(Point(std::stoull(coordinates[shift-2]), std::stoull(coordinates[shift-1])));
-                Rectangle r3 = r1 + r2;
-                coordinates[shift-4] = std::to_string(r3.x);
-                coordinates[shift-3] = std::to_string(r3.y);
-                coordinates[shift-2] = "";
-                coordinates[shift-1] = "";
-                shift -= 2;
-                plus = false;
+            else if (c == ' ' || c == '\r' || c == '\t')
+                continue;
+            else if (c == '(' && !bracket)
+                bracket = true;
+            else if (c == ',' && bracket && shift == 0) {
+                if (!digits)
+                    throw std::invalid_argument("point must have two coordinates");
+                shift = 1;
+                digits = false;
             }
-
-            if (c == '*')
-                multi = true;
+            else if (c == ')' && bracket) {
+                bracket = false;
+                push_point();
+            }
+            else if ((c == '*' || c == '+') && !bracket)
+                push_operator(c);
+            else if (c == '\n')
+                return it;
             else
-                plus = true;
+                throw std::invalid_argument(std::string("unexpected character '") + c + '\'');
+        }
+        return end;
+    }
+
+    /**
+     * Finishes the piece of expression fed so far and prepares the evaluator for the next one.
+    */
+    PartialSum finish() {
+        if (bracket || !has_product || pending_multiply)
+            throw std::invalid_argument("incomplete expression");
 
+        PartialSum result = partial;
+        if (result.split) {
+            result.tail_x = product_x;
+            result.tail_y = product_y;
+        } else {
+            result.head_x = product_x;
+            result.head_y = product_y;
         }
-        else if (bracket){
-            coordinates[shift] += c;
+        *this = ExpressionEvaluator();
+        return result;
+    }
+
+    /**
+     * Finishes the expression and prepares the evaluator for the next one.
+    */
+    Rectangle result() {
+        return value(finish());
+    }
+};
+
+Rectangle processed_string(std::string const &expression){
+    ExpressionEvaluator evaluator;
+    evaluator.feed(expression.data(), expression.data() + expression.size());
+    return evaluator.result();
+}
+
+/**
+ * Evaluates the first line of the stream reading it in fixed chunks, so the whole expression is never stored.
+*/
+Rectangle processed_stream(std::istream &input){
+    const std::size_t chunk_size = 1 << 16;
+    char* chunk = new char[chunk_size];
+    ExpressionEvaluator evaluator;
+
+    try {
+        while (input) {
+            input.read(chunk, chunk_size);
+            char const* end = chunk + input.gcount();
+            if (evaluator.feed(chunk, end) != end)
+                break;
+        }
+    } catch (...) {
+        delete [] chunk;
+        throw;
+    }
+    delete [] chunk;
+    return evaluator.result();
+}
+
+/**
+ * Evaluates a long expression on several threads. The expression is cut at operators into one piece per thread,
+ * the pieces are evaluated independently and their partial sums are reduced pairwise as a tree.
+*/
+Rectangle evaluate_parallel(char const* begin, char const* end, unsigned threads) {
+    std::vector<char const*> cuts{begin};
+    std::vector<char> ops{'+'};
+    for (unsigned t = 1; t < threads; t++) {
+        char const* cut = std::max(begin + (end - begin) * t / threads, cuts.back());
+        while (cut != end && *cut != '+' && *cut != '*')
+            cut++;
+        if (cut == end)
+            break;
+        ops.push_back(*cut);
+        cuts.push_back(cut + 1);
+    }
+
+    std::size_t pieces = cuts.size();
+    std::vector<PartialSum> partials(pieces);
+    std::vector<std::exception_ptr> errors(pieces);
+    auto run = [&](std::size_t idx) {
+        try {
+            ExpressionEvaluator evaluator;
+            evaluator.feed(cuts[idx], idx + 1 < pieces ? cuts[idx + 1] - 1 : end);
+            partials[idx] = evaluator.finish();
+        } catch (...) {
+            errors[idx] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t idx = 1; idx < pieces; idx++)
+        workers.emplace_back(run, idx);
+    run(0);
+    for (auto &worker : workers)
+        worker.join();
+    for (auto &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    // ops[idx] joins piece idx to the pieces before it and stays valid while the merged pieces grow
+    for (std::size_t stride = 1; stride < pieces; stride *= 2)
+        for (std::size_t idx = 0; idx + stride < pieces; idx += 2 * stride)
+            partials[idx] = combine(partials[idx], ops[idx + stride], partials[idx + stride]);
+    return value(partials[0]);
+}
+
+/**
+ * Read-only memory mapping of a whole file.
+*/
+class MappedFile {
+private:
+    char const* mapping = nullptr;
+    std::size_t length = 0;
+
+public:
+    explicit MappedFile(char const* path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error(std::string("Cannot open file ") + path + ": " + strerror(errno));
+        struct stat info;
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw std::runtime_error(std::string("Cannot stat file ") + path + ": " + strerror(errno));
+        }
+
+        length = info.st_size;
+        if (length) {
+            void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error(std::string("Cannot map file ") + path + ": " + strerror(errno));
+            }
+            madvise(data, length, MADV_SEQUENTIAL);
+            mapping = (char const*)data;
         }
+        close(fd);
     }
-    return Rectangle(Point(std::stoull(coordinates[0]), std::stoull(coordinates[1])));
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile& operator =(MappedFile const &) = delete;
+
+    ~MappedFile() {
+        if (mapping)
+            munmap((void*)mapping, length);
+    }
+
+    char const* begin() const { return mapping; }
+    char const* end() const { return mapping + length; }
+};
+
+void append_result(std::string &buffer, Rectangle const &result) {
+    // 20 digits fit any unsigned long long
+    char text[2 * 20 + 4];
+    char* it = text;
+    *it++ = '(';
+    it = std::to_chars(it, it + 20, result.x).ptr;
+    *it++ = ',';
+    it = std::to_chars(it, it + 20, result.y).ptr;
+    *it++ = ')';
+    *it++ = '\n';
+    buffer.append(text, it);
 }
 
-int main() {
-    std::string expression;
-    std::getline(std::cin, expression);
+/**
+ * Evaluates every line of the file as a separate expression and writes one result per line in the order of lines.
+ * The file is mapped into memory and cut at line boundaries into one range per thread. Every thread renders its
+ * results into its own buffer, and the buffers are written in order as soon as their threads finish.
+ * Malformed lines produce "error: ..." lines, empty lines stay empty.
+ *
+ * @param path file with one expression per line.
+ * @param output stream for the results.
+ * @param threads number of threads.
+ * @param long_line lines of at least this many bytes are evaluated by evaluate_parallel.
+*/
+void evaluate_file(char const* path, std::ostream &output, unsigned threads = std::thread::hardware_concurrency(),
+                   std::size_t long_line = 1 << 20) {
+    MappedFile file(path);
+    char const* begin = file.begin();
+    char const* end = file.end();
+    // an empty file is not mapped at all
+    if (begin == end)
+        return;
+    if (threads < 1)
+        threads = 1;
+
+    std::vector<char const*> bounds{begin};
+    for (unsigned t = 1; t < threads; t++) {
+        char const* cut = std::max(begin + (end - begin) * t / threads, bounds.back());
+        cut = (char const*)memchr(cut, '\n', end - cut);
+        if (!cut || cut + 1 == end)
+            break;
+        bounds.push_back(cut + 1);
+    }
+    bounds.push_back(end);
+
+    std::size_t ranges = bounds.size() - 1;
+    // threads that got no range of lines help with long lines
+    unsigned line_threads = threads / ranges;
+    std::vector<std::string> buffers(ranges);
+
+    auto run = [&](std::size_t idx) {
+        std::string &buffer = buffers[idx];
+        ExpressionEvaluator evaluator;
+        for (char const* line = bounds[idx]; line < bounds[idx + 1];) {
+            char const* line_end = (char const*)memchr(line, '\n', bounds[idx + 1] - line);
+            if (!line_end)
+                line_end = bounds[idx + 1];
+
+            if (line != line_end && !(line_end - line == 1 && *line == '\r')) {
+                try {
+                    if (line_threads > 1 && (std::size_t)(line_end - line) >= long_line)
+                        append_result(buffer, evaluate_parallel(line, line_end, line_threads));
+                    else {
+                        evaluator.feed(line, line_end);
+                        append_result(buffer, evaluator.result());
+                    }
+                } catch (std::exception const &error) {
+                    evaluator = ExpressionEvaluator();
+                    buffer += "error: ";
+                    buffer += error.what();
+                    buffer += '\n';
+                }
+            } else
+                buffer += '\n';
+            line = line_end + 1;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t idx = 1; idx < ranges; idx++)
+        workers.emplace_back(run, idx);
+    run(0);
+    output.write(buffers[0].data(), buffers[0].size());
+    for (std::size_t idx = 1; idx < ranges; idx++) {
+        workers[idx - 1].join();
+        output.write(buffers[idx].data(), buffers[idx].size());
+        std::string().swap(buffers[idx]);
+    }
+    output.flush();
+}
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    if (argc > 1) {
+        evaluate_file(argv[1], std::cout);
+        return 0;
+    }
 
-    processed_string(expression).print();
+    processed_stream(std::cin).print();
 //    Point p1(2, 3);
 //    Point p2(3, 1);
 //    Rectangle r1(p1);
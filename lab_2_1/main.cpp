@@ -1,8 +1,15 @@
 #include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+const size_t insertion_threshold = 16;
+const size_t parallel_threshold = 1 << 15;
 
 int compare(const void* x1, const void* x2){
     auto x = *(double *)x1 - *(double *)x2;
-    return (x > 0)? 1 : abs(x - 0) < 1e-5  ? -1: 0;
+    return (x > 1e-5)? 1 : (x < -1e-5) ? -1 : 0;
 }
 
 void swap(void* first, void* second, size_t size){
@@ -17,24 +24,233 @@ void swap(void* first, void* second, size_t size){
 //    free(buffer);
 }
 
-void qsort(void* first, size_t number, size_t size, int (*comparator)(const void*, const void*)) {
-    if (number <= 1)
-        return;
-    size_t num_left = 0;
-    void* ptr = first;
-
-    for (size_t i = number - 1; i > 0; i--){
-        void* tmp = (char*) first + size * i;
-        if (comparator(ptr, tmp) < 0 && i < num_left || comparator(ptr, tmp) >= 0 && i > num_left) {
-            swap(ptr, tmp, size);
-            ptr = tmp;
-            num_left = i;
+enum class KeyType { Int32, UInt32, Int64, UInt64, Float, Double };
+
+// Numeric key stored at offset bytes from the beginning of every element.
+struct SortKey {
+    size_t offset;
+    KeyType type;
+};
+
+template <size_t bytes>
+struct FixedSwap {
+    static constexpr size_t size = bytes;
+
+    void operator()(char* first, char* second) const {
+        char buffer[bytes];
+        memcpy(buffer, first, bytes);
+        memcpy(first, second, bytes);
+        memcpy(second, buffer, bytes);
+    }
+};
+
+struct WordSwap {
+    size_t size;
+
+    void operator()(char* first, char* second) const {
+        for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+            uint64_t buffer;
+            memcpy(&buffer, first + i, sizeof(uint64_t));
+            memcpy(first + i, second + i, sizeof(uint64_t));
+            memcpy(second + i, &buffer, sizeof(uint64_t));
         }
     }
+};
+
+struct GenericSwap {
+    size_t size;
+
+    void operator()(char* first, char* second) const {
+        swap(first, second, size);
+    }
+};
+
+struct FunctionCompare {
+    int (*comparator)(const void*, const void*);
+
+    int operator()(const void* x1, const void* x2) const {
+        return comparator(x1, x2);
+    }
+};
+
+template <typename K>
+struct KeyCompare {
+    size_t offset;
+
+    int operator()(const void* x1, const void* x2) const {
+        K key1, key2;
+        memcpy(&key1, (const char*)x1 + offset, sizeof(K));
+        memcpy(&key2, (const char*)x2 + offset, sizeof(K));
+        return key1 < key2 ? -1 : key2 < key1;
+    }
+};
+
+template <typename Swap, typename Compare>
+void insertion_sort(char* first, size_t number, Swap swapper, Compare comparator) {
+    const size_t size = swapper.size;
+    for (size_t i = 1; i < number; i++)
+        for (char* tmp = first + size * i; tmp != first && comparator(tmp, tmp - size) < 0; tmp -= size)
+            swapper(tmp, tmp - size);
+}
+
+template <typename Swap, typename Compare>
+void sift_down(char* first, size_t root, size_t number, Swap swapper, Compare comparator) {
+    const size_t size = swapper.size;
+    for (size_t child = 2 * root + 1; child < number; root = child, child = 2 * root + 1) {
+        if (child + 1 < number && comparator(first + size * child, first + size * (child + 1)) < 0)
+            child++;
+        if (comparator(first + size * root, first + size * child) >= 0)
+            return;
+        swapper(first + size * root, first + size * child);
+    }
+}
+
+template <typename Swap, typename Compare>
+void heap_sort(char* first, size_t number, Swap swapper, Compare comparator) {
+    for (size_t i = number / 2; i > 0; i--)
+        sift_down(first, i - 1, number, swapper, comparator);
+    for (size_t i = number - 1; i > 0; i--) {
+        swapper(first, first + swapper.size * i);
+        sift_down(first, 0, i, swapper, comparator);
+    }
+}
+
+template <typename Swap, typename Compare>
+void move_median_to_first(char* result, char* a, char* b, char* c, Swap swapper, Compare comparator) {
+    if (comparator(a, b) < 0) {
+        if (comparator(b, c) < 0)
+            swapper(result, b);
+        else if (comparator(a, c) < 0)
+            swapper(result, c);
+        else
+            swapper(result, a);
+    }
+    else if (comparator(a, c) < 0)
+        swapper(result, a);
+    else if (comparator(b, c) < 0)
+        swapper(result, c);
+    else
+        swapper(result, b);
+}
+
+// Moves median of three to the first element and partitions the rest around it.
+// The median guarantees an element on both sides of the pivot, so the scans need no bound checks.
+template <typename Swap, typename Compare>
+char* partition(char* first, size_t number, Swap swapper, Compare comparator) {
+    const size_t size = swapper.size;
+    char* last = first + size * number;
+    move_median_to_first(first, first + size, first + size * (number / 2), last - size, swapper, comparator);
+
+    char* left = first + size;
+    char* right = last;
+    while (true) {
+        while (comparator(left, first) < 0)
+            left += size;
+        right -= size;
+        while (comparator(first, right) < 0)
+            right -= size;
+        if (left >= right)
+            return left;
+        swapper(left, right);
+        left += size;
+    }
+}
 
-    qsort(first, num_left, size, comparator);
-    if (num_left + 1 < number)
-        qsort((void*)((char*)ptr + 1), number - num_left - 1, size, comparator);
+size_t depth_limit(size_t number) {
+    size_t depth = 0;
+    for (; number > 1; number >>= 1)
+        depth += 2;
+    return depth;
+}
+
+template <typename Swap, typename Compare>
+void introsort(char* first, size_t number, Swap swapper, Compare comparator, size_t depth) {
+    while (number > insertion_threshold) {
+        if (!depth) {
+            heap_sort(first, number, swapper, comparator);
+            return;
+        }
+        depth--;
+
+        char* cut = partition(first, number, swapper, comparator);
+        size_t num_left = (cut - first) / swapper.size;
+        if (num_left < number - num_left) {
+            introsort(first, num_left, swapper, comparator, depth);
+            first = cut;
+            number -= num_left;
+        } else {
+            introsort(cut, number - num_left, swapper, comparator, depth);
+            number = num_left;
+        }
+    }
+    insertion_sort(first, number, swapper, comparator);
+}
+
+template <typename Swap, typename Compare>
+void parallel_introsort(char* first, size_t number, Swap swapper, Compare comparator, size_t depth, unsigned threads) {
+    if (number <= parallel_threshold || threads < 2 || !depth) {
+        introsort(first, number, swapper, comparator, depth);
+        return;
+    }
+
+    char* cut = partition(first, number, swapper, comparator);
+    size_t num_left = (cut - first) / swapper.size;
+    std::thread right(parallel_introsort<Swap, Compare>, cut, number - num_left, swapper, comparator, depth - 1, threads / 2);
+    parallel_introsort(first, num_left, swapper, comparator, depth - 1, threads - threads / 2);
+    right.join();
+}
+
+// Picks the swap kernel for the element size once per sort call.
+template <typename Compare>
+void sort_dispatch(void* first, size_t number, size_t size, Compare comparator, unsigned threads) {
+    char* begin = (char*)first;
+    size_t depth = depth_limit(number);
+
+    if (size == 4)
+        parallel_introsort(begin, number, FixedSwap<4>(), comparator, depth, threads);
+    else if (size == 8)
+        parallel_introsort(begin, number, FixedSwap<8>(), comparator, depth, threads);
+    else if (size == 16)
+        parallel_introsort(begin, number, FixedSwap<16>(), comparator, depth, threads);
+    else if (size % sizeof(uint64_t) == 0)
+        parallel_introsort(begin, number, WordSwap{size}, comparator, depth, threads);
+    else
+        parallel_introsort(begin, number, GenericSwap{size}, comparator, depth, threads);
+}
+
+template <typename K>
+void sort_by_key(void* first, size_t number, size_t size, size_t offset, unsigned threads) {
+    sort_dispatch(first, number, size, KeyCompare<K>{offset}, threads);
+}
+
+void key_dispatch(void* first, size_t number, size_t size, SortKey key, unsigned threads) {
+    switch (key.type) {
+        case KeyType::Int32:  sort_by_key<int32_t>(first, number, size, key.offset, threads); break;
+        case KeyType::UInt32: sort_by_key<uint32_t>(first, number, size, key.offset, threads); break;
+        case KeyType::Int64:  sort_by_key<int64_t>(first, number, size, key.offset, threads); break;
+        case KeyType::UInt64: sort_by_key<uint64_t>(first, number, size, key.offset, threads); break;
+        case KeyType::Float:  sort_by_key<float>(first, number, size, key.offset, threads); break;
+        case KeyType::Double: sort_by_key<double>(first, number, size, key.offset, threads); break;
+    }
+}
+
+void qsort(void* first, size_t number, size_t size, int (*comparator)(const void*, const void*)) {
+    sort_dispatch(first, number, size, FunctionCompare{comparator}, 1);
+}
+
+void qsort_parallel(void* first, size_t number, size_t size, int (*comparator)(const void*, const void*),
+                    unsigned threads = std::thread::hardware_concurrency()) {
+    sort_dispatch(first, number, size, FunctionCompare{comparator}, threads);
+}
+
+// Sorts elements by the numeric key without calling any comparator.
+void qsort(void* first, size_t number, size_t size, SortKey key) {
+    key_dispatch(first, number, size, key, 1);
+}
+
+void qsort_parallel(void* first, size_t number, size_t size, SortKey key,
+                    unsigned threads = std::thread::hardware_concurrency()) {
+    key_dispatch(first, number, size, key, threads);
 }
 
 int main() {
@@ -43,6 +259,28 @@ int main() {
     qsort(vector, 5, sizeof(*vector), compare);
     for(double i : vector)
         std::cout << i << ' ';
+    std::cout << '\n';
+
+    const size_t number = 1000000;
+    auto sorted = new double[number];
+    for (size_t i = 0; i < number; i++)
+        sorted[i] = (double)(i % 1000) * 1000 + (double)(i / 1000);
+
+    qsort_parallel(sorted, number, sizeof(*sorted), compare);
+    bool ok = true;
+    for (size_t i = 1; i < number; i++)
+        ok &= compare(sorted + i - 1, sorted + i) <= 0;
+    std::cout << ok << '\n';
+    delete [] sorted;
+
+    struct Item {
+        int id;
+        double weight;
+    } items[] = {{1, 2.5}, {2, -1}, {3, 0.5}, {4, 2}};
+
+    qsort(items, 4, sizeof(*items), SortKey{offsetof(Item, weight), KeyType::Double});
+    for (auto item : items)
+        std::cout << item.id << ' ';
 
     return 0;
 }
@@ -3,10 +3,263 @@
 #include <random>
 #include <utility>
 #include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+// Set of integers with representation chosen by its density: a bitset over [min, max] for compact ranges,
+// a sorted array with branchless binary search for small sparse sets and an open addressing hash table for large sparse ones.
+class IntSet {
+public:
+    enum class Kind { Bitset, Sorted, Hash };
+
+private:
+    static constexpr std::size_t bitset_span = 1 << 16;
+    static constexpr std::size_t bitset_density = 128;
+    static constexpr std::size_t sorted_size = 4096;
+
+    Kind kind = Kind::Sorted;
+    int min = 0;
+    unsigned span = 0;
+    int empty_key = 0;
+    unsigned shift = 64;
+    std::vector<std::uint64_t> bits;
+    std::vector<int> values;
+
+    std::size_t slot(int s) const {
+        return (std::size_t)(((std::uint64_t)(unsigned)s * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    bool bitset_contains(int s) const {
+        unsigned const d = (unsigned)s - (unsigned)min;
+        return d < span && (bits[d >> 6] >> (d & 63) & 1);
+    }
+
+    bool sorted_contains(int s) const {
+        std::size_t len = values.size();
+        if (!len)
+            return false;
+        int const *base = values.data();
+        while (len > 1) {
+            std::size_t const half = len / 2;
+            base += (base[half - 1] < s) * half;
+            len -= half;
+        }
+        return *base == s;
+    }
+
+    bool hash_contains(int s) const {
+        std::size_t const mask = values.size() - 1;
+        for (std::size_t idx = slot(s); ; idx = (idx + 1) & mask) {
+            if (values[idx] == s)
+                return s != empty_key;
+            if (values[idx] == empty_key)
+                return false;
+        }
+    }
+
+public:
+    IntSet() = default;
+
+    explicit IntSet(std::set<int> const &src) {
+        if (src.empty())
+            return;
+        min = *src.begin();
+        int const max = *src.rbegin();
+        std::uint64_t const width = (std::uint64_t)((std::int64_t)max - min) + 1;
+
+        if (width <= bitset_span || width <= bitset_density * src.size()) {
+            kind = Kind::Bitset;
+            span = (unsigned)width;
+            bits.assign((width + 63) / 64, 0);
+            for (int s : src) {
+                unsigned const d = (unsigned)s - (unsigned)min;
+                bits[d >> 6] |= 1ull << (d & 63);
+            }
+        } else if (src.size() <= sorted_size || (min == std::numeric_limits<int>::min() && max == std::numeric_limits<int>::max())) {
+            kind = Kind::Sorted;
+            values.assign(src.begin(), src.end());
+        } else {
+            kind = Kind::Hash;
+            empty_key = min != std::numeric_limits<int>::min() ? min - 1 : max + 1;
+            std::size_t capacity = 1;
+            for (shift = 64; capacity < 2 * src.size(); capacity *= 2)
+                --shift;
+            values.assign(capacity, empty_key);
+            for (int s : src) {
+                std::size_t idx = slot(s);
+                while (values[idx] != empty_key)
+                    idx = (idx + 1) & (capacity - 1);
+                values[idx] = s;
+            }
+        }
+    }
+
+    Kind get_kind() const {
+        return kind;
+    }
+
+    // Returns elements in increasing order.
+    std::vector<int> elements() const {
+        std::vector<int> result;
+        if (kind == Kind::Bitset) {
+            for (unsigned d = 0; d < span; d++)
+                if (bits[d >> 6] >> (d & 63) & 1)
+                    result.push_back((int)((unsigned)min + d));
+        } else if (kind == Kind::Sorted) {
+            result = values;
+        } else {
+            for (int s : values)
+                if (s != empty_key)
+                    result.push_back(s);
+            std::sort(result.begin(), result.end());
+        }
+        return result;
+    }
+
+    bool contains(int s) const {
+        switch (kind) {
+            case Kind::Bitset: return bitset_contains(s);
+            case Kind::Sorted: return sorted_contains(s);
+            default: return hash_contains(s);
+        }
+    }
+
+    // Same as contains for every sample, the representation is chosen once for the whole block.
+    std::size_t count_matches(int const *samples, std::size_t count) const {
+        std::size_t good = 0;
+        switch (kind) {
+            case Kind::Bitset:
+                for (std::size_t idx = 0; idx != count; ++idx)
+                    good += bitset_contains(samples[idx]);
+                break;
+            case Kind::Sorted:
+                for (std::size_t idx = 0; idx != count; ++idx)
+                    good += sorted_contains(samples[idx]);
+                break;
+            default:
+                for (std::size_t idx = 0; idx != count; ++idx)
+                    good += hash_contains(samples[idx]);
+        }
+        return good;
+    }
+};
+
+// Canonical form of an integer state set: sorted disjoint intervals [lo, hi] with gaps between neighbours.
+// Bounds are kept in long long, so complements over the whole int range do not overflow.
+class IntervalSet {
+private:
+    std::vector<std::pair<long long, long long>> intervals;
+
+    static constexpr long long lowest = std::numeric_limits<int>::min();
+    static constexpr long long highest = std::numeric_limits<int>::max();
+
+    // Sorts intervals and merges overlapping and adjacent ones.
+    void normalize() {
+        std::sort(intervals.begin(), intervals.end());
+        std::size_t size = 0;
+        for (auto const &interval : intervals) {
+            if (size && interval.first <= intervals[size - 1].second + 1)
+                intervals[size - 1].second = std::max(intervals[size - 1].second, interval.second);
+            else
+                intervals[size++] = interval;
+        }
+        intervals.resize(size);
+    }
+
+public:
+    IntervalSet() = default;
+
+    IntervalSet(long long lo, long long hi) {
+        if (lo <= hi)
+            intervals.emplace_back(lo, hi);
+    }
+
+    static IntervalSet from_elements(std::vector<int> const &elements) {
+        IntervalSet result;
+        for (int s : elements)
+            result.intervals.emplace_back(s, s);
+        result.normalize();
+        return result;
+    }
+
+    std::vector<std::pair<long long, long long>> const &get_intervals() const {
+        return intervals;
+    }
+
+    IntervalSet operator|(IntervalSet const &rha) const {
+        IntervalSet result(*this);
+        result.intervals.insert(result.intervals.end(), rha.intervals.begin(), rha.intervals.end());
+        result.normalize();
+        return result;
+    }
+
+    IntervalSet operator&(IntervalSet const &rha) const {
+        IntervalSet result;
+        for (std::size_t i = 0, j = 0; i < intervals.size() && j < rha.intervals.size(); ) {
+            long long const lo = std::max(intervals[i].first, rha.intervals[j].first);
+            long long const hi = std::min(intervals[i].second, rha.intervals[j].second);
+            if (lo <= hi)
+                result.intervals.emplace_back(lo, hi);
+            if (intervals[i].second < rha.intervals[j].second)
+                ++i;
+            else
+                ++j;
+        }
+        return result;
+    }
+
+    // Complement within the int range.
+    IntervalSet operator~() const {
+        IntervalSet result;
+        long long next = lowest;
+        for (auto const &interval : intervals) {
+            if (next < interval.first)
+                result.intervals.emplace_back(next, interval.first - 1);
+            next = interval.second + 1;
+        }
+        if (next <= highest)
+            result.intervals.emplace_back(next, highest);
+        return result;
+    }
+
+    IntervalSet operator-(IntervalSet const &rha) const {
+        return *this & ~rha;
+    }
+
+    // Number of integers of [lo, hi] in the set.
+    unsigned long long measure(long long lo, long long hi) const {
+        unsigned long long result = 0;
+        for (auto const &interval : intervals) {
+            long long const from = std::max(lo, interval.first);
+            long long const to = std::min(hi, interval.second);
+            if (from <= to)
+                result += to - from + 1;
+        }
+        return result;
+    }
+};
 
 class Predicate {
 public:
     virtual bool operator()(int s) const = 0;
+
+    // Counts samples satisfying the predicate, subclasses override it with loops without virtual calls.
+    virtual std::size_t count_matches(int const *samples, std::size_t count) const {
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            if ((*this)(samples[idx])) ++good;
+        return good;
+    }
+
+    // Canonical interval form of the states, predicates that cannot be compiled throw std::logic_error.
+    virtual IntervalSet intervals() const {
+        throw std::logic_error("Predicate cannot be compiled to intervals.");
+    }
 };
 
 class DiscreteState: public Predicate {
@@ -19,6 +272,17 @@ public:
     bool operator()(int s) const override {
         return s == state;
     }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            good += samples[idx] == state;
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return IntervalSet(state, state);
+    }
 };
 
 class SegmentState: public Predicate {
@@ -32,60 +296,105 @@ public:
     bool operator()(int s) const override {
         return s >= beg && s <= end;
     }
+
+    // One unsigned compare per sample checks both bounds.
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        if (end < beg)
+            return 0;
+        unsigned const width = (unsigned)end - (unsigned)beg;
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            good += (unsigned)samples[idx] - (unsigned)beg <= width;
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return IntervalSet(beg, end);
+    }
 };
 
 class SetState: public Predicate {
 private:
-    std::set<int> const states;
+    IntSet const states;
 
 public:
     SetState(): states() { }
-    explicit SetState(std::set<int> src): states(std::move(src)) { }
+    explicit SetState(std::set<int> const &src): states(src) { }
 
     bool operator()(int s) const override {
-        return states.count(s) > 0;
+        return states.contains(s);
+    }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        return states.count_matches(samples, count);
+    }
+
+    IntervalSet intervals() const override {
+        return IntervalSet::from_elements(states.elements());
     }
 };
 
 class SegmentHoleState: public Predicate {
 private:
     int const beg, end;
-    std::set<int> const holes;
+    IntSet const holes;
 
 public:
-    explicit SegmentHoleState(int beg, int end, std::set<int> src): beg(beg), end(end), holes(std::move(src)) { }
+    explicit SegmentHoleState(int beg, int end, std::set<int> src): beg(beg), end(end), holes(src) { }
     explicit SegmentHoleState(): SegmentHoleState(0, -1, {}) {}
     explicit SegmentHoleState(int beg, int end): SegmentHoleState(beg, end, {}) {}
 
     bool operator()(int s) const override {
-        return (s >= beg && s <= end) && (!holes.count(s));
+        return (s >= beg && s <= end) && (!holes.contains(s));
+    }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            good += SegmentHoleState::operator()(samples[idx]);
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return IntervalSet(beg, end) - IntervalSet::from_elements(holes.elements());
     }
 };
 
 class SegmentAddState: public Predicate {
 private:
     int const beg, end;
-    std::set<int> const add;
+    IntSet const add;
 
 public:
-    explicit SegmentAddState(int beg, int end, std::set<int> src): beg(beg), end(end), add(std::move(src)) {}
+    explicit SegmentAddState(int beg, int end, std::set<int> src): beg(beg), end(end), add(src) {}
     explicit SegmentAddState(): SegmentAddState(0, -1, {}) {}
     explicit SegmentAddState(int beg, int end): SegmentAddState(beg, end, {}) {}
     explicit SegmentAddState(std::set<int> src): SegmentAddState(0, -1, std::move(src)) {}
 
     bool operator()(int s) const override {
-        return (s >= beg && s <= end) || (add.count(s));
+        return (s >= beg && s <= end) || (add.contains(s));
+    }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            good += SegmentAddState::operator()(samples[idx]);
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return IntervalSet(beg, end) | IntervalSet::from_elements(add.elements());
     }
 };
 
 class SegmentHoleAddState: public Predicate {
 private:
     int const beg, end;
-    std::set<int> const holes;
-    std::set<int> const add;
+    IntSet const holes;
+    IntSet const add;
 
 public:
-    explicit SegmentHoleAddState(int beg, int end, std::set<int> holes, std::set<int> add): beg(beg), end(end), holes(std::move(holes)), add(std::move(add)) { }
+    explicit SegmentHoleAddState(int beg, int end, std::set<int> holes, std::set<int> add): beg(beg), end(end), holes(holes), add(add) { }
     explicit SegmentHoleAddState(): SegmentHoleAddState(0, -1, {}, {}) {}
     explicit SegmentHoleAddState(int beg, int end): SegmentHoleAddState(beg, end, {}, {}) {}
     explicit SegmentHoleAddState(std::set<int> holes, std::set<int> add): SegmentHoleAddState(0, -1, holes, add) { }
@@ -93,12 +402,142 @@ public:
 
 
     bool operator()(int s) const override {
-        return (s >= beg && s <= end) && (!holes.count(s)) || add.count(s);
+        return (s >= beg && s <= end) && (!holes.contains(s)) || add.contains(s);
+    }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        std::size_t good = 0;
+        for (std::size_t idx = 0; idx != count; ++idx)
+            good += SegmentHoleAddState::operator()(samples[idx]);
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return (IntervalSet(beg, end) - IntervalSet::from_elements(holes.elements())) | IntervalSet::from_elements(add.elements());
+    }
+};
+
+// Predicate compiled to interval form. Compact sets are checked by a bitmap lookup and others by a branchless
+// binary search over interval starts, so any composition costs the same as one lookup.
+class CompiledState: public Predicate {
+private:
+    static constexpr long long bitmap_span = 1 << 20;
+
+    IntervalSet const set;
+    std::vector<long long> starts, ends;
+    long long min = 0, span = 0;
+    std::vector<std::uint64_t> bits;
+
+    bool search(int s) const {
+        std::size_t len = starts.size();
+        if (!len)
+            return false;
+        long long const *base = starts.data();
+        while (len > 1) {
+            std::size_t const half = len / 2;
+            base += (base[half] <= s) * half;
+            len -= half;
+        }
+        return *base <= s && s <= ends[base - starts.data()];
+    }
+
+    bool lookup(int s) const {
+        unsigned long long const d = (unsigned long long)(s - min);
+        return d < (unsigned long long)span && (bits[d >> 6] >> (d & 63) & 1);
+    }
+
+public:
+    explicit CompiledState(IntervalSet src): set(std::move(src)) {
+        for (auto const &interval : set.get_intervals()) {
+            starts.push_back(interval.first);
+            ends.push_back(interval.second);
+        }
+        if (starts.empty() || ends.back() - starts.front() >= bitmap_span)
+            return;
+
+        min = starts.front();
+        span = ends.back() - min + 1;
+        bits.assign((span + 63) / 64, 0);
+        for (std::size_t i = 0; i < starts.size(); i++)
+            for (long long d = starts[i] - min; d <= ends[i] - min; d++)
+                bits[d >> 6] |= 1ull << (d & 63);
+    }
+
+    explicit CompiledState(Predicate const &predicate): CompiledState(predicate.intervals()) { }
+
+    bool operator()(int s) const override {
+        return bits.empty() ? search(s) : lookup(s);
+    }
+
+    std::size_t count_matches(int const *samples, std::size_t count) const override {
+        std::size_t good = 0;
+        if (bits.empty())
+            for (std::size_t idx = 0; idx != count; ++idx)
+                good += search(samples[idx]);
+        else
+            for (std::size_t idx = 0; idx != count; ++idx)
+                good += lookup(samples[idx]);
+        return good;
+    }
+
+    IntervalSet intervals() const override {
+        return set;
+    }
+};
+
+CompiledState operator|(Predicate const &lha, Predicate const &rha) {
+    return CompiledState(lha.intervals() | rha.intervals());
+}
+
+CompiledState operator&(Predicate const &lha, Predicate const &rha) {
+    return CompiledState(lha.intervals() & rha.intervals());
+}
+
+CompiledState operator~(Predicate const &predicate) {
+    return CompiledState(~predicate.intervals());
+}
+
+// Counter-based Philox4x32-10 generator: block number counter of stream key is mapped to four random words,
+// so any sample can be generated independently of others and threads need no shared state.
+class Philox {
+private:
+    std::uint32_t const key0, key1;
+
+    static void mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t &hi, std::uint32_t &lo) {
+        std::uint64_t product = (std::uint64_t)a * b;
+        hi = product >> 32;
+        lo = (std::uint32_t)product;
+    }
+
+public:
+    explicit Philox(std::uint64_t key): key0((std::uint32_t)key), key1(key >> 32) { }
+
+    void operator()(std::uint64_t counter, std::uint32_t out[4]) const {
+        std::uint32_t c0 = (std::uint32_t)counter, c1 = counter >> 32, c2 = 0, c3 = 0;
+        std::uint32_t k0 = key0, k1 = key1;
+        for (int round = 0; round < 10; round++) {
+            std::uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c0, hi0, lo0);
+            mulhilo(0xCD9E8D57u, c2, hi1, lo1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
     }
 };
 
 class ProbabilityTest {
 private:
+    // Samples are generated by blocks and every block is checked by one Predicate::count_matches call.
+    static constexpr unsigned block_size = 4096;
+
     unsigned seed;
     int test_min, test_max;
     unsigned test_count;
@@ -111,12 +550,113 @@ public:
     float operator()(Predicate const &predicate) const {
         std::default_random_engine rng(seed);
         std::uniform_int_distribution<int> dstr(test_min, test_max);
-        unsigned good = 0;
-        for (unsigned cnt = 0; cnt != test_count; ++cnt)
-            if (predicate(dstr(rng))) ++good;
+        int samples[block_size];
+        std::size_t good = 0;
+        for (unsigned left = test_count; left;) {
+            unsigned const count = std::min(block_size, left);
+            for (unsigned idx = 0; idx != count; ++idx)
+                samples[idx] = dstr(rng);
+            good += predicate.count_matches(samples, count);
+            left -= count;
+        }
 
         return static_cast<float>(good) / static_cast<float>(test_count);
     }
+
+    /**
+     * Exact probability of the predicate for the uniform distribution on [test_min, test_max] computed from its intervals.
+     */
+    float exact(Predicate const &predicate) const {
+        auto const good = predicate.intervals().measure(test_min, test_max);
+        return static_cast<float>(good) / static_cast<float>((long long)test_max - test_min + 1);
+    }
+
+    /**
+     * Splits samples between threads. Sample number idx is built from Philox block idx / 2 of the seed stream,
+     * so the result for a given seed does not depend on the number of threads.
+     */
+    float parallel(Predicate const &predicate, unsigned threads = std::thread::hardware_concurrency()) const {
+        threads = std::max(1u, std::min(threads, std::max(1u, test_count)));
+        Philox philox(seed);
+        std::uint64_t const range = (std::uint64_t)((std::int64_t)test_max - test_min) + 1;
+
+        auto count = [&](unsigned begin, unsigned end, unsigned long long &good) {
+            std::uint32_t block[4];
+            int samples[block_size];
+            // first never steps past end, so the loop stays correct for test_count close to UINT_MAX
+            for (unsigned first = begin, last; first != end; first = last) {
+                last = std::min(end - first, block_size) + first;
+                for (unsigned idx = first; idx < last; ++idx) {
+                    if (idx == first || idx % 2 == 0)
+                        philox(idx / 2, block);
+                    std::uint64_t bits = (std::uint64_t)block[2 * (idx % 2)] << 32 | block[2 * (idx % 2) + 1];
+                    samples[idx - first] = (int)(test_min + (std::int64_t)(((unsigned __int128)bits * range) >> 64));
+                }
+                good += predicate.count_matches(samples, last - first);
+            }
+        };
+
+        std::vector<unsigned long long> good(threads, 0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+            workers.emplace_back(count, (unsigned)((std::uint64_t)test_count * t / threads),
+                                 (unsigned)((std::uint64_t)test_count * (t + 1) / threads), std::ref(good[t]));
+        count(0, (unsigned)((std::uint64_t)test_count / threads), good[0]);
+        for (auto &worker : workers)
+            worker.join();
+
+        unsigned long long total = 0;
+        for (auto g : good)
+            total += g;
+        return static_cast<float>(total) / static_cast<float>(test_count);
+    }
+};
+
+// Sample stream of one seed shared by a whole sweep. Samples are drawn once and reused as prefixes,
+// so the first test_count samples are the same as ProbabilityTest(seed, test_min, test_max, test_count) draws.
+class ProbabilitySweep {
+private:
+    std::default_random_engine rng;
+    std::uniform_int_distribution<int> dstr;
+    int const test_min, test_max;
+    std::vector<int> samples;
+
+public:
+    ProbabilitySweep(unsigned seed, int test_min, int test_max): rng(seed), dstr(test_min, test_max), test_min(test_min), test_max(test_max) { }
+
+    int const *draw(unsigned test_count) {
+        while (samples.size() < test_count)
+            samples.push_back(dstr(rng));
+        return samples.data();
+    }
+
+    // Number of occurrences of every value of [test_min, test_max] among the first test_count samples.
+    std::vector<unsigned> histogram(unsigned test_count) {
+        std::vector<unsigned> counts((std::size_t)((long long)test_max - test_min + 1), 0);
+        int const *values = draw(test_count);
+        for (unsigned idx = 0; idx != test_count; ++idx)
+            ++counts[values[idx] - test_min];
+        return counts;
+    }
+};
+
+// Running count of samples satisfying the predicate, growing test_count only checks the new samples.
+class SweepTally {
+private:
+    Predicate const &predicate;
+    unsigned counted = 0;
+    std::size_t good = 0;
+
+public:
+    explicit SweepTally(Predicate const &predicate): predicate(predicate) { }
+
+    float operator()(ProbabilitySweep &sweep, unsigned test_count) {
+        if (test_count < counted)
+            counted = good = 0;
+        good += predicate.count_matches(sweep.draw(test_count) + counted, test_count - counted);
+        counted = test_count;
+        return static_cast<float>(good) / static_cast<float>(test_count);
+    }
 };
 
 void task1(int test_count) {
@@ -126,25 +666,34 @@ void task1(int test_count) {
     task1_ss.open("task1_ss.txt");
     SegmentState s(0,10);
     SetState ss({1, 3, 5, 7, 23, 48, 57, 60, 90, 99});
+    ProbabilitySweep sweep(10, 0, 100);
+    SweepTally tally_s(s), tally_ss(ss);
     for (int idx = 1; idx < test_count; idx+=200) {
-        ProbabilityTest pt(10, 0, 100, idx);
-        task1_s << idx << ' ' << pt(s) << std::endl;
-        task1_ss << idx << ' ' << pt(ss) << std::endl;
+        task1_s << idx << ' ' << tally_s(sweep, idx) << '\n';
+        task1_ss << idx << ' ' << tally_ss(sweep, idx) << '\n';
     }
     task1_s.close();
     task1_ss.close();
 }
 
+// Segment [0, idx] grows by one value per step, so its count grows by the number of samples equal to idx.
 void task2(int number=10000) {
     std::ofstream task2_s;
 
     task2_s.open("task2_s.txt");
 
+    unsigned const test_count = 10000;
+    ProbabilitySweep sweep(10, 0, 10000);
+    auto counts = sweep.histogram(test_count);
+    std::size_t good = 0;
+    for (int idx = 0; idx < 1000 && idx < (int)counts.size(); idx++)
+        good += counts[idx];
+
     for (int idx = 1000; idx < number; idx++) {
-        SegmentState s(0, idx);
-        ProbabilityTest pt(10, 0, 10000, 10000);
-        auto p = pt(s);
-        task2_s << idx << ' ' << p << ' ' << round(10000 * p) << std::endl;
+        if (idx < (int)counts.size())
+            good += counts[idx];
+        auto p = static_cast<float>(good) / static_cast<float>(test_count);
+        task2_s << idx << ' ' << p << ' ' << round(10000 * p) << '\n';
     }
     task2_s.close();
 }
@@ -154,26 +703,38 @@ void task3(bool discrete=true, int test_count=100000, bool set=true, int number=
         std::ofstream task3_d;
         DiscreteState d(1);
         task3_d.open("task3_d.txt");
-        for (int idx = 1; idx < test_count; idx += test_count / 1000) {
-            ProbabilityTest pt(10, 0, 100, idx);
-            task3_d << idx << ' ' << pt(d) << std::endl;
-        }
+        ProbabilitySweep sweep(10, 0, 100);
+        SweepTally tally(d);
+        for (int idx = 1; idx < test_count; idx += test_count / 1000)
+            task3_d << idx << ' ' << tally(sweep, idx) << '\n';
         task3_d.close();
     }
+    // The state of step idx holds the first idx values of one random stream, so every step adds a single value
+    // and the count grows by the number of samples equal to it.
     if (set) {
         std::ofstream task3_ss;
         task3_ss.open("task3_ss.txt");
         std::default_random_engine rng(seed);
         std::uniform_int_distribution<int> dstr(0, 1000);
+
+        unsigned const samples = 10000;
+        ProbabilitySweep sweep(10, 0, 10000);
+        auto counts = sweep.histogram(samples);
+        std::vector<bool> state(1001, false);
+        std::size_t good = 0;
+        auto add = [&](int value) {
+            if (!state[value]) {
+                state[value] = true;
+                good += counts[value];
+            }
+        };
+
+        for (int i = 0; i < 1000 && i < number; i++)
+            add(dstr(rng));
         for (int idx = 1000; idx < number; idx ++) {
-            std::set<int> state;
-            for (int i = 0; i < idx; i++)
-                state.insert(dstr(rng));
-
-            SetState ss(state);
-            ProbabilityTest pt(10, 0, 10000, 10000);
-            auto p = pt(ss);
-            task3_ss << idx << ' ' << p << ' ' << round(10000 * p) << std::endl;
+            auto p = static_cast<float>(good) / static_cast<float>(samples);
+            task3_ss << idx << ' ' << p << ' ' << round(10000 * p) << '\n';
+            add(dstr(rng));
         }
         task3_ss.close();
     }
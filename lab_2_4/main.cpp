@@ -1,4 +1,17 @@
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <chrono>
+#include <random>
 
 class ComplexInt {
 private:
@@ -46,45 +59,343 @@ struct DoubleComparator final : Comparator<double> {
 
 struct ComplexComparator final :Comparator<ComplexInt> {
     bool operator ()( ComplexInt const &lha , ComplexInt const &rha) const override {
-        const int r1 = lha.get_real();
-        const int i1 = lha.get_image();
-        const int r2 = rha.get_real();
-        const int i2 = rha.get_image();
+        return norm(lha) < norm(rha) ;
+    }
 
-        return r1*r1 + i1*i1 < r2*r2 + i2*i2 ;
+    // Squares are taken in 64 bits, so the norm never overflows and RadixKey<ComplexInt> orders by the same value.
+    static unsigned long long norm(ComplexInt const &value) {
+        const long long r = value.get_real();
+        const long long i = value.get_image();
+        return (unsigned long long)(r*r) + (unsigned long long)(i*i);
     }
 };
 
 template <typename T>
 void swap(T* first, T* second) {
-    size_t size = sizeof(*first);
+    const size_t size = sizeof(*first);
     char buffer[size];
     memcpy(buffer, first, size);
     memcpy(first, second, size);
     memcpy(second, buffer, size);
 }
 
+const size_t insertion_threshold = 16;
+
+template <typename T, typename Compare>
+void insertion_sort(T* first, size_t number, Compare const &comparator) {
+    for (size_t i = 1; i < number; i++)
+        for (T* tmp = first + i; tmp != first && comparator(*tmp, tmp[-1]); tmp--)
+            swap(tmp, tmp - 1);
+}
+
+template <typename T, typename Compare>
+void sift_down(T* first, size_t root, size_t number, Compare const &comparator) {
+    for (size_t child = 2 * root + 1; child < number; root = child, child = 2 * root + 1) {
+        if (child + 1 < number && comparator(first[child], first[child + 1]))
+            child++;
+        if (!comparator(first[root], first[child]))
+            return;
+        swap(first + root, first + child);
+    }
+}
+
+template <typename T, typename Compare>
+void heap_sort(T* first, size_t number, Compare const &comparator) {
+    for (size_t i = number / 2; i > 0; i--)
+        sift_down(first, i - 1, number, comparator);
+    for (size_t i = number - 1; i > 0; i--) {
+        swap(first, first + i);
+        sift_down(first, 0, i, comparator);
+    }
+}
+
+template <typename T, typename Compare>
+void move_median_to_first(T* result, T* a, T* b, T* c, Compare const &comparator) {
+    if (comparator(*a, *b)) {
+        if (comparator(*b, *c))
+            swap(result, b);
+        else if (comparator(*a, *c))
+            swap(result, c);
+        else
+            swap(result, a);
+    }
+    else if (comparator(*a, *c))
+        swap(result, a);
+    else if (comparator(*b, *c))
+        swap(result, c);
+    else
+        swap(result, b);
+}
+
+// Hoare partition around the median of three moved to the first element. Both scans stop on keys equal to the pivot,
+// so runs of equal keys are split in halves instead of all going to one side.
+template <typename T, typename Compare>
+T* partition(T* first, size_t number, Compare const &comparator) {
+    T* last = first + number;
+    move_median_to_first(first, first + 1, first + number / 2, last - 1, comparator);
+
+    T* left = first + 1;
+    T* right = last;
+    while (true) {
+        while (comparator(*left, *first))
+            left++;
+        right--;
+        while (comparator(*first, *right))
+            right--;
+        if (left >= right)
+            return left;
+        swap(left, right);
+        left++;
+    }
+}
+
+size_t depth_limit(size_t number) {
+    size_t depth = 0;
+    for (; number > 1; number >>= 1)
+        depth += 2;
+    return depth;
+}
+
+// Recurses into the smaller side and loops on the larger one, so the stack depth stays O(log n).
+// Falls back to heap sort when partitions keep being unbalanced.
+template <typename T, typename Compare>
+void introsort(T* first, size_t number, Compare const &comparator, size_t depth) {
+    while (number > insertion_threshold) {
+        if (!depth) {
+            heap_sort(first, number, comparator);
+            return;
+        }
+        depth--;
+
+        T* cut = partition(first, number, comparator);
+        size_t num_left = cut - first;
+        if (num_left < number - num_left) {
+            introsort(first, num_left, comparator, depth);
+            first = cut;
+            number -= num_left;
+        } else {
+            introsort(cut, number - num_left, comparator, depth);
+            number = num_left;
+        }
+    }
+    insertion_sort(first, number, comparator);
+}
+
+// Comparator is a template parameter, so final comparators and lambdas are inlined into the loop.
+template <typename T, typename Compare>
+void qsort(T* first, size_t number, Compare const &comparator) {
+    introsort(first, number, comparator, depth_limit(number));
+}
+
+// Called for comparators known only by the abstract base, every comparison is a virtual call.
 template <typename T>
 void qsort(T* first, size_t number, Comparator<T> const &comparator) {
+    qsort<T, Comparator<T>>(first, number, comparator);
+}
+
+const size_t radix_threshold = 256;
+const size_t parallel_histogram_threshold = 1 << 20;
+
+// Maps values to unsigned keys whose order matches the order of the type comparator.
+template <typename T> struct RadixKey;
+
+template <> struct RadixKey<int> {
+    using type = uint32_t;
+    using comparator = IntComparator;
+
+    static type get(int const &value) {
+        return (type)value ^ 0x80000000u;
+    }
+};
+
+template <> struct RadixKey<float> {
+    using type = uint32_t;
+    using comparator = FloatComparator;
+
+    static type get(float const &value) {
+        type bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+};
+
+template <> struct RadixKey<double> {
+    using type = uint64_t;
+    using comparator = DoubleComparator;
+
+    static type get(double const &value) {
+        type bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x8000000000000000u) ? ~bits : bits | 0x8000000000000000u;
+    }
+};
+
+template <> struct RadixKey<ComplexInt> {
+    using type = uint64_t;
+    using comparator = ComplexComparator;
+
+    static type get(ComplexInt const &value) {
+        return ComplexComparator::norm(value);
+    }
+};
+
+template <typename Key>
+void count_digits(Key const* keys, size_t number, size_t (*counts)[256]) {
+    for (size_t i = 0; i < number; i++)
+        for (size_t digit = 0; digit < sizeof(Key); digit++)
+            counts[digit][(keys[i] >> (8 * digit)) & 0xFF]++;
+}
+
+template <typename Key>
+void histogram(Key const* keys, size_t number, size_t (*counts)[256]) {
+    unsigned threads = std::thread::hardware_concurrency();
+    if (number < parallel_histogram_threshold || threads < 2) {
+        count_digits(keys, number, counts);
+        return;
+    }
+
+    auto partial = new size_t[threads][sizeof(Key)][256]();
+    std::vector<std::thread> workers;
+    size_t chunk = (number + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t begin = std::min(number, chunk * t);
+        size_t end = std::min(number, begin + chunk);
+        workers.emplace_back(count_digits<Key>, keys + begin, end - begin, partial[t]);
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    for (unsigned t = 0; t < threads; t++)
+        for (size_t digit = 0; digit < sizeof(Key); digit++)
+            for (size_t bucket = 0; bucket < 256; bucket++)
+                counts[digit][bucket] += partial[t][digit][bucket];
+    delete [] partial;
+}
+
+// Stable LSD radix sort by byte digits of RadixKey<T>. Passes where all keys share the digit are skipped.
+template <typename T>
+void radix_sort(T* first, size_t number) {
+    using Key = typename RadixKey<T>::type;
     if (number <= 1)
         return;
-    size_t num_left = 0;
-    T* ptr = first;
 
-    for (size_t i = number-1; i > 0; i--){
-        T* tmp = first + i;
-        if (comparator(*ptr, *tmp) && i < num_left || !(comparator(*ptr, *tmp)) && i > num_left) {
-            swap(ptr, tmp);
-            ptr = tmp;
-            num_left = i;
+    auto keys = new Key[number];
+    auto keys_buffer = new Key[number];
+    auto values_buffer = new char[number * sizeof(T)];
+    for (size_t i = 0; i < number; i++)
+        keys[i] = RadixKey<T>::get(first[i]);
+
+    size_t counts[sizeof(Key)][256] = {};
+    histogram(keys, number, counts);
+
+    char* values = (char*)first;
+    for (size_t digit = 0; digit < sizeof(Key); digit++) {
+        const size_t shift = 8 * digit;
+        if (counts[digit][(keys[0] >> shift) & 0xFF] == number)
+            continue;
+
+        size_t offsets[256];
+        size_t sum = 0;
+        for (size_t bucket = 0; bucket < 256; bucket++) {
+            offsets[bucket] = sum;
+            sum += counts[digit][bucket];
+        }
+
+        for (size_t i = 0; i < number; i++) {
+            size_t idx = offsets[(keys[i] >> shift) & 0xFF]++;
+            keys_buffer[idx] = keys[i];
+            memcpy(values_buffer + idx * sizeof(T), values + i * sizeof(T), sizeof(T));
         }
+        std::swap(keys, keys_buffer);
+        std::swap(values, values_buffer);
     }
 
-    qsort(first, num_left, comparator);
-    if (num_left + 1 < number)
-        qsort(ptr + 1, number - num_left - 1, comparator);
+    if (values != (char*)first) {
+        memcpy(first, values, number * sizeof(T));
+        values_buffer = values;
+    }
+    delete [] keys;
+    delete [] keys_buffer;
+    delete [] values_buffer;
 }
 
+// Sorts types that have RadixKey: radix sort for large arrays and qsort with RadixKey<T>::comparator for small ones.
+// The comparator orders by the same key, so the result does not depend on the array size.
+template <typename T>
+void sort(T* first, size_t number) {
+    if (number < radix_threshold)
+        qsort(first, number, typename RadixKey<T>::comparator{});
+    else
+        radix_sort(first, number);
+}
+
+// Slab allocator for nodes of one type. Nodes are carved from cache-line aligned chunks,
+// freed nodes go to a free list and release() frees whole chunks at once.
+template <typename Node>
+class NodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(Node) unsigned char storage[sizeof(Node)];
+    };
+
+    static constexpr size_t chunk_bytes = 4096;
+    static constexpr size_t slots_per_chunk = chunk_bytes / sizeof(Slot) ? chunk_bytes / sizeof(Slot) : 1;
+
+    struct alignas(64) Chunk {
+        Slot slots[slots_per_chunk];
+        Chunk* next;
+    };
+
+    Chunk* chunks = nullptr;
+    Slot* free_list = nullptr;
+    size_t used = slots_per_chunk;
+
+public:
+    NodePool() = default;
+    NodePool(NodePool const &) = delete;
+    NodePool& operator=(NodePool const &) = delete;
+
+    Node* allocate() {
+        Slot* slot;
+        if (free_list) {
+            slot = free_list;
+            free_list = free_list->next;
+        } else {
+            if (used == slots_per_chunk) {
+                auto chunk = new Chunk;
+                chunk->next = chunks;
+                chunks = chunk;
+                used = 0;
+            }
+            slot = &chunks->slots[used++];
+        }
+        return new (slot->storage) Node();
+    }
+
+    void deallocate(Node* node) {
+        node->~Node();
+        auto slot = reinterpret_cast<Slot*>(node);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    // Frees all chunks without visiting nodes, live nodes must be destroyed before if they own resources.
+    void release() {
+        while (chunks) {
+            auto next = chunks->next;
+            delete chunks;
+            chunks = next;
+        }
+        free_list = nullptr;
+        used = slots_per_chunk;
+    }
+
+    ~NodePool() {
+        release();
+    }
+};
+
 template <typename T>
 struct BinaryTree{
     T data = NULL;
@@ -97,6 +408,7 @@ template <typename T>
 class PriorityQueue {
 private:
     BinaryTree<T>* tree = nullptr;
+    NodePool<BinaryTree<T>> pool;
 
     void update_height(BinaryTree<T>* root){
         if (!root)
@@ -161,15 +473,21 @@ private:
         return (root->left_branch) ? search_max(root->left_branch) : root;
     }
 
-    BinaryTree<T>* search_prev_max(BinaryTree<T>* root){
-        return (root->left_branch) ? (root->left_branch->left_branch) ? search_prev_max(root->left_branch) : root : root;
+    BinaryTree<T>* remove_max(BinaryTree<T>* root){
+        if (!root->left_branch){
+            auto right = root->right_branch;
+            pool.deallocate(root);
+            return right;
+        }
+        root->left_branch = remove_max(root->left_branch);
+        return balance_tree(root);
     }
 
     void delete_tree(BinaryTree<T>* root){
         if (root){
             delete_tree(root->left_branch);
             delete_tree(root->right_branch);
-            delete root;
+            pool.deallocate(root);
         }
     }
 
@@ -177,7 +495,7 @@ public:
     PriorityQueue(): tree() {}
 
     void push(T data) {
-        auto branch = new BinaryTree<T>;
+        auto branch = pool.allocate();
         branch->data = data;
         tree = insert(tree, branch);
     }
@@ -189,33 +507,556 @@ public:
     }
 
     void poll(){
-        auto max = search_max(tree);
-        auto prev_max = search_prev_max(tree);
-        auto right = max->right_branch;
-        delete max;
-        prev_max->left_branch = right ? right : nullptr;
+        if (tree)
+            tree = remove_max(tree);
+    }
 
-        tree = balance_tree(tree);
+    void clear(){
+        if (!std::is_trivially_destructible<T>::value)
+            delete_tree(tree);
+        tree = nullptr;
+        pool.release();
     }
 
     ~PriorityQueue(){
-        delete_tree(tree);
+        clear();
+    }
+};
+
+// Max-queue stored as an implicit 4-ary heap in one contiguous array.
+// Children of node idx are 4 * idx + 1 ... 4 * idx + 4, so all of them usually share a cache line.
+template <typename T>
+class HeapPriorityQueue {
+private:
+    static constexpr size_t arity = 4;
+    std::vector<T> heap;
+
+    void sift_up(size_t idx){
+        T value = std::move(heap[idx]);
+        while (idx > 0){
+            size_t parent = (idx - 1) / arity;
+            if (!(heap[parent] < value))
+                break;
+            heap[idx] = std::move(heap[parent]);
+            idx = parent;
+        }
+        heap[idx] = std::move(value);
+    }
+
+    void sift_down(size_t idx){
+        const size_t size = heap.size();
+        T value = std::move(heap[idx]);
+        for (size_t child = arity * idx + 1; child < size; child = arity * idx + 1){
+            size_t max = child;
+            for (size_t i = child + 1, last = std::min(child + arity, size); i < last; i++)
+                if (heap[max] < heap[i])
+                    max = i;
+            if (!(value < heap[max]))
+                break;
+            heap[idx] = std::move(heap[max]);
+            idx = max;
+        }
+        heap[idx] = std::move(value);
+    }
+
+public:
+    HeapPriorityQueue(): heap() {}
+
+    /**
+     * Builds the queue from range [first, last) in O(n).
+     */
+    template <typename Iterator>
+    HeapPriorityQueue(Iterator first, Iterator last): heap(first, last) {
+        for (size_t idx = heap.size() / arity + 1; idx > 0; idx--)
+            if (idx - 1 < heap.size())
+                sift_down(idx - 1);
+    }
+
+    void reserve(size_t capacity) {
+        heap.reserve(capacity);
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    void push(T data) {
+        heap.push_back(std::move(data));
+        sift_up(heap.size() - 1);
+    }
+
+    T peek() {
+        if (!heap.empty())
+            return heap.front();
+        return 0;
+    }
+
+    void poll(){
+        if (heap.empty())
+            return;
+        heap.front() = std::move(heap.back());
+        heap.pop_back();
+        if (!heap.empty())
+            sift_down(0);
     }
 };
 
-int main() {
+// Max-queue with stable handles. push returns a handle that stays valid until the element is polled or erased,
+// so the priority of an element can be changed or the element removed in O(log n).
+template <typename T>
+class IndexedPriorityQueue {
+public:
+    // Slot of the element in the low 32 bits and generation of the slot in the high ones. Slots are reused after
+    // erase with the next generation, so a handle of an erased element never refers to a newer one.
+    using handle_type = uint64_t;
+
+private:
+    using slot_type = uint32_t;
+
+    static constexpr size_t arity = 4;
+    static constexpr size_t npos = -1;
+
+    std::vector<slot_type> heap;
+    std::vector<size_t> position;
+    std::vector<uint32_t> generation;
+    std::vector<T> priority;
+    std::vector<slot_type> free_slots;
+
+    static slot_type slot_of(handle_type handle) {
+        return (slot_type)handle;
+    }
+
+    handle_type handle_of(slot_type slot) const {
+        return (handle_type)generation[slot] << 32 | slot;
+    }
+
+    bool less(slot_type lha, slot_type rha) const {
+        return priority[lha] < priority[rha];
+    }
+
+    void place(size_t idx, slot_type slot){
+        heap[idx] = slot;
+        position[slot] = idx;
+    }
+
+    void sift_up(size_t idx){
+        slot_type slot = heap[idx];
+        while (idx > 0){
+            size_t parent = (idx - 1) / arity;
+            if (!less(heap[parent], slot))
+                break;
+            place(idx, heap[parent]);
+            idx = parent;
+        }
+        place(idx, slot);
+    }
+
+    void sift_down(size_t idx){
+        const size_t size = heap.size();
+        slot_type slot = heap[idx];
+        for (size_t child = arity * idx + 1; child < size; child = arity * idx + 1){
+            size_t max = child;
+            for (size_t i = child + 1, last = std::min(child + arity, size); i < last; i++)
+                if (less(heap[max], heap[i]))
+                    max = i;
+            if (!less(slot, heap[max]))
+                break;
+            place(idx, heap[max]);
+            idx = max;
+        }
+        place(idx, slot);
+    }
+
+    void restore(size_t idx){
+        if (idx > 0 && less(heap[(idx - 1) / arity], heap[idx]))
+            sift_up(idx);
+        else
+            sift_down(idx);
+    }
+
+    void heapify(){
+        for (size_t idx = heap.size() / arity + 1; idx > 0; idx--)
+            if (idx - 1 < heap.size())
+                sift_down(idx - 1);
+    }
+
+public:
+    IndexedPriorityQueue(): heap() {}
+
+    void reserve(size_t capacity) {
+        heap.reserve(capacity);
+        position.reserve(capacity);
+        generation.reserve(capacity);
+        priority.reserve(capacity);
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    bool contains(handle_type handle) const {
+        slot_type slot = slot_of(handle);
+        return slot < position.size() && position[slot] != npos && generation[slot] == handle >> 32;
+    }
+
+    handle_type push(T data) {
+        slot_type slot;
+        if (!free_slots.empty()) {
+            slot = free_slots.back();
+            free_slots.pop_back();
+            priority[slot] = std::move(data);
+        } else {
+            slot = priority.size();
+            priority.push_back(std::move(data));
+            position.push_back(npos);
+            generation.push_back(0);
+        }
+        heap.push_back(slot);
+        position[slot] = heap.size() - 1;
+        sift_up(heap.size() - 1);
+        return handle_of(slot);
+    }
+
+    T peek() {
+        if (!heap.empty())
+            return priority[heap.front()];
+        return 0;
+    }
+
+    handle_type peek_handle() const {
+        return heap.empty() ? npos : handle_of(heap.front());
+    }
+
+    T get(handle_type handle) const {
+        assert(contains(handle));
+        return priority[slot_of(handle)];
+    }
+
+    void poll(){
+        if (!heap.empty())
+            erase(handle_of(heap.front()));
+    }
+
+    /**
+     * Changes priority of the element. Returns false and changes nothing if the handle was erased or never issued.
+     */
+    bool update(handle_type handle, T data) {
+        if (!contains(handle))
+            return false;
+        slot_type slot = slot_of(handle);
+        priority[slot] = std::move(data);
+        restore(position[slot]);
+        return true;
+    }
+
+    /**
+     * Applies updates from range of (handle, priority) pairs. Large batches rebuild the heap in O(n)
+     * instead of sifting every element. Pairs with handles that are not in the queue are skipped.
+     */
+    template <typename Iterator>
+    void update(Iterator first, Iterator last) {
+        size_t number = std::distance(first, last);
+        if (number * arity < heap.size()) {
+            for (; first != last; ++first)
+                update(first->first, first->second);
+            return;
+        }
+        for (; first != last; ++first)
+            if (contains(first->first))
+                priority[slot_of(first->first)] = first->second;
+        heapify();
+    }
+
+    /**
+     * Removes the element. Returns false and changes nothing if the handle was erased or never issued.
+     */
+    bool erase(handle_type handle) {
+        if (!contains(handle))
+            return false;
+        slot_type slot = slot_of(handle);
+        size_t idx = position[slot];
+        slot_type last = heap.back();
+        heap.pop_back();
+        position[slot] = npos;
+        generation[slot]++;
+        free_slots.push_back(slot);
+        if (idx < heap.size()) {
+            place(idx, last);
+            restore(idx);
+        }
+        return true;
+    }
+};
+
+// Thread-safe relaxed max-queue built from several heaps guarded by their own mutexes (MultiQueue).
+// push goes to a random free shard, peek and poll look at choices random shards and take the largest top.
+// choices trades exactness for throughput: 2 is the usual relaxed setting, choices >= shards scans all of them
+// under locks and returns the exact maximum.
+template <typename T>
+class ConcurrentPriorityQueue {
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        HeapPriorityQueue<T> heap;
+    };
+
+    static constexpr size_t max_shards = 256;
+
+    size_t const shard_count;
+    unsigned const choices;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<size_t> count{0};
+
+    static size_t random_index(size_t bound) {
+        static thread_local std::minstd_rand rng(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        return rng() % bound;
+    }
+
+    // Locks sampled shards in increasing order and returns how many of them are in idx.
+    size_t lock_sample(size_t* idx, bool all) {
+        size_t sampled = 0;
+        if (all || choices >= shard_count) {
+            for (size_t i = 0; i < shard_count; i++)
+                idx[sampled++] = i;
+        } else {
+            for (unsigned i = 0; i < choices; i++)
+                idx[sampled++] = random_index(shard_count);
+            std::sort(idx, idx + sampled);
+            sampled = std::unique(idx, idx + sampled) - idx;
+        }
+        for (size_t i = 0; i < sampled; i++)
+            shards[idx[i]].mutex.lock();
+        return sampled;
+    }
+
+    void unlock_sample(size_t const* idx, size_t sampled) {
+        for (size_t i = sampled; i > 0; i--)
+            shards[idx[i - 1]].mutex.unlock();
+    }
+
+    Shard* max_shard(size_t const* idx, size_t sampled) {
+        Shard* max = nullptr;
+        for (size_t i = 0; i < sampled; i++) {
+            Shard* shard = &shards[idx[i]];
+            if (!shard->heap.empty() && (!max || max->heap.peek() < shard->heap.peek()))
+                max = shard;
+        }
+        return max;
+    }
+
+public:
+    explicit ConcurrentPriorityQueue(size_t shard_count = 2 * std::max(1u, std::thread::hardware_concurrency()), unsigned choices = 2):
+        shard_count(std::min(std::max<size_t>(shard_count, 1), max_shards)), choices(std::max(choices, 1u)), shards(new Shard[this->shard_count]) {}
+
+    ConcurrentPriorityQueue(ConcurrentPriorityQueue const &) = delete;
+    ConcurrentPriorityQueue& operator=(ConcurrentPriorityQueue const &) = delete;
+
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    void push(T data) {
+        size_t i = random_index(shard_count);
+        while (!shards[i].mutex.try_lock())
+            i = random_index(shard_count);
+        shards[i].heap.push(std::move(data));
+        // counted under the shard lock, so a consumer that pops the element always decrements after this
+        count.fetch_add(1, std::memory_order_relaxed);
+        shards[i].mutex.unlock();
+    }
+
+    /**
+     * Removes the largest top of the sampled shards. Falls back to all shards if the sampled ones are empty,
+     * so false is returned only if the queue was empty.
+     */
+    bool try_poll(T &value) {
+        size_t idx[max_shards];
+        for (bool all : {false, true}) {
+            if (all && !size())
+                return false;
+            size_t sampled = lock_sample(idx, all);
+            Shard* max = max_shard(idx, sampled);
+            if (max) {
+                value = max->heap.peek();
+                max->heap.poll();
+                count.fetch_sub(1, std::memory_order_relaxed);
+                unlock_sample(idx, sampled);
+                return true;
+            }
+            unlock_sample(idx, sampled);
+        }
+        return false;
+    }
+
+    /**
+     * Reads the largest top of the sampled shards. Falls back to all shards if the sampled ones are empty,
+     * so false is returned only if the queue was empty.
+     */
+    bool try_peek(T &value) {
+        size_t idx[max_shards];
+        for (bool all : {false, true}) {
+            if (all && !size())
+                return false;
+            size_t sampled = lock_sample(idx, all);
+            Shard* max = max_shard(idx, sampled);
+            if (max)
+                value = max->heap.peek();
+            unlock_sample(idx, sampled);
+            if (max)
+                return true;
+        }
+        return false;
+    }
+
+    // Returns T() only if the queue is empty, use try_peek when T() can be a real element.
+    T peek() {
+        T value{};
+        try_peek(value);
+        return value;
+    }
+
+    void poll() {
+        T value;
+        try_poll(value);
+    }
+};
+
+void benchmark_qsort(size_t number) {
+    std::default_random_engine rng(10);
+    std::uniform_int_distribution<int> dstr;
+    auto source = new int[number];
+    auto values = new int[number];
+    for (size_t i = 0; i < number; i++)
+        source[i] = dstr(rng);
+
+    IntComparator int_comp{};
+    Comparator<int> const &virtual_comp = int_comp;
+    auto measure = [&](auto sort) {
+        memcpy(values, source, number * sizeof(int));
+        auto start = std::chrono::steady_clock::now();
+        sort();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::cout << "virtual: " << measure([&] { qsort(values, number, virtual_comp); }) << " ms\n";
+    std::cout << "static: " << measure([&] { qsort(values, number, int_comp); }) << " ms\n";
+    std::cout << "lambda: " << measure([&] { qsort(values, number, [](int lha, int rha) { return lha < rha; }); }) << " ms\n";
+
+    delete [] source;
+    delete [] values;
+}
+
+template <typename Queue>
+double measure_queue(double const *values, size_t number) {
+    auto start = std::chrono::steady_clock::now();
+    Queue queue{};
+    for (size_t i = 0; i < number; i++)
+        queue.push(values[i]);
+    for (size_t i = 0; i < number; i++) {
+        queue.peek();
+        queue.poll();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_priority_queue(size_t number) {
+    std::default_random_engine rng(10);
+    std::uniform_real_distribution<double> dstr;
+    auto values = new double[number];
+    for (size_t i = 0; i < number; i++)
+        values[i] = dstr(rng);
+
+    std::cout << "tree queue: " << measure_queue<PriorityQueue<double>>(values, number) << " ms\n";
+    std::cout << "heap queue: " << measure_queue<HeapPriorityQueue<double>>(values, number) << " ms\n";
+
+    auto start = std::chrono::steady_clock::now();
+    HeapPriorityQueue<double> heap(values, values + number);
+    std::cout << "heapify: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+
+    delete [] values;
+}
+
+// Producers push number values in total while consumers poll them, returns operations per second.
+double measure_concurrent_queue(size_t number, unsigned producers, unsigned consumers, size_t shards, unsigned choices) {
+    ConcurrentPriorityQueue<long long> queue(shards, choices);
+    std::atomic<size_t> polled{0};
+    std::atomic<long long> sum{0};
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned p = 0; p < producers; p++)
+        threads.emplace_back([&, p] {
+            for (size_t i = p; i < number; i += producers)
+                queue.push((long long)i);
+        });
+    for (unsigned c = 0; c < consumers; c++)
+        threads.emplace_back([&] {
+            long long value, local = 0;
+            while (polled.load() < number)
+                if (queue.try_poll(value)) {
+                    local += value;
+                    polled++;
+                }
+            sum += local;
+        });
+    for (auto &thread : threads)
+        thread.join();
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    assert(sum == (long long)number * ((long long)number - 1) / 2);
+    return 2 * number / seconds;
+}
+
+void benchmark_concurrent_queue(size_t number) {
+    for (unsigned threads : {1u, 2u, 4u}) {
+        size_t shards = 4 * threads;
+        std::cout << threads << "+" << threads << " threads, relaxed: " << measure_concurrent_queue(number, threads, threads, shards, 2) << " ops/s\n";
+        std::cout << threads << "+" << threads << " threads, exact: " << measure_concurrent_queue(number, threads, threads, shards, shards) << " ops/s\n";
+    }
+}
+
+int main(int argc, char** argv) {
     int vector[] = {11, 13, 21, 11, 20, 221, 89, -13};
 
     IntComparator int_comp{};
     qsort(vector, 8, int_comp);
     for(double i : vector)
         std::cout << i << ' ';
+
+    double doubles[] = {2.5, -1e10, 0, -0.5, 3e-7, 1e300, -2.5};
+    radix_sort(doubles, 7);
+    std::cout << '\n';
+    for(double i : doubles)
+        std::cout << i << ' ';
     PriorityQueue<double> tree{};
     for (double i : vector)
         tree.push(i);
     std::cout << '\n' << tree.peek() << '\n';
     tree.poll();
-    std::cout << tree.peek();
+    std::cout << tree.peek() << '\n';
+
+    IndexedPriorityQueue<int> indexed{};
+    auto first = indexed.push(5);
+    auto second = indexed.push(10);
+    indexed.push(7);
+    indexed.update(first, 12);
+    indexed.erase(second);
+    std::cout << indexed.peek() << ' ' << (indexed.peek_handle() == first) << '\n';
+
+    // benchmarks take seconds, so they run only with --benchmark
+    if (argc > 1 && !strcmp(argv[1], "--benchmark")) {
+        benchmark_qsort(1000000);
+        benchmark_priority_queue(1000000);
+        benchmark_concurrent_queue(1000000);
+    }
 
     return 0;
 }
@@ -0,0 +1,236 @@
+/**
+ * This header file is part of {{lab_2_5}}.
+ *
+ * There are defined lazy element-wise expressions over grids. An expression like a + b * 2.0f only keeps references
+ * to its operands and is evaluated in a single pass when it is assigned to a grid, so no intermediate grids are created.
+*/
+#ifndef EXPRESSION
+#define EXPRESSION
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Base of all expressions. E is the expression type itself, it must provide value_type, operator[] and size().
+*/
+template <typename E>
+struct Expression {
+    E const& self() const {
+        return static_cast<E const&>(*this);
+    }
+};
+
+/**
+ * Leaf expression that reads elements of a contiguous grid.
+*/
+template <typename T>
+class Terminal final: public Expression<Terminal<T>> {
+private:
+    T const* data;
+    std::size_t count;
+
+public:
+    using value_type = T;
+
+    Terminal(T const* data, std::size_t count): data(data), count(count) {}
+
+    T operator [](std::size_t idx) const { return data[idx]; }
+    std::size_t size() const { return count; }
+};
+
+/**
+ * Leaf expression that broadcasts one value. Size 0 means that it fits grids of any size.
+*/
+template <typename T>
+class Scalar final: public Expression<Scalar<T>> {
+private:
+    T value;
+
+public:
+    using value_type = T;
+
+    explicit Scalar(T value): value(value) {}
+
+    T operator [](std::size_t) const { return value; }
+    std::size_t size() const { return 0; }
+};
+
+template <typename Op, typename A>
+class Unary final: public Expression<Unary<Op, A>> {
+private:
+    A arg;
+
+public:
+    using value_type = decltype(Op{}(std::declval<typename A::value_type>()));
+
+    explicit Unary(A arg): arg(arg) {}
+
+    value_type operator [](std::size_t idx) const { return Op{}(arg[idx]); }
+    std::size_t size() const { return arg.size(); }
+};
+
+template <typename Op, typename L, typename R>
+class Binary final: public Expression<Binary<Op, L, R>> {
+private:
+    L lhs;
+    R rhs;
+
+public:
+    using value_type = decltype(Op{}(std::declval<typename L::value_type>(), std::declval<typename R::value_type>()));
+
+    Binary(L lhs, R rhs): lhs(lhs), rhs(rhs) {
+        assert(!lhs.size() || !rhs.size() || lhs.size() == rhs.size());
+    }
+
+    value_type operator [](std::size_t idx) const { return Op{}(lhs[idx], rhs[idx]); }
+    std::size_t size() const { return lhs.size() ? lhs.size() : rhs.size(); }
+};
+
+struct Add { template <typename A, typename B> auto operator ()(A a, B b) const { return a + b; } };
+struct Sub { template <typename A, typename B> auto operator ()(A a, B b) const { return a - b; } };
+struct Mul { template <typename A, typename B> auto operator ()(A a, B b) const { return a * b; } };
+struct Div { template <typename A, typename B> auto operator ()(A a, B b) const { return a / b; } };
+struct Neg { template <typename A> auto operator ()(A a) const { return -a; } };
+struct Sqrt { template <typename A> auto operator ()(A a) const { return std::sqrt(a); } };
+struct Abs { template <typename A> auto operator ()(A a) const { return std::abs(a); } };
+struct Exp { template <typename A> auto operator ()(A a) const { return std::exp(a); } };
+
+// Grids take part in expressions by specializing is_grid as true. They must have begin() and end() returning pointers
+// to contiguous elements. Opt-in keeps other contiguous types like std::array out of the operators below.
+template <typename G>
+struct is_grid: std::false_type {};
+
+template <typename X>
+struct is_expression: std::is_base_of<Expression<X>, X> {};
+
+template <typename X>
+constexpr bool is_operand = is_grid<X>::value || is_expression<X>::value || std::is_arithmetic<X>::value;
+
+template <typename L, typename R>
+constexpr bool is_binary_operand = is_operand<L> && is_operand<R> && !(std::is_arithmetic<L>::value && std::is_arithmetic<R>::value);
+
+template <typename E>
+E to_expression(Expression<E> const &expression) {
+    return expression.self();
+}
+
+template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+Scalar<T> to_expression(T value) {
+    return Scalar<T>(value);
+}
+
+template <typename G, typename = std::enable_if_t<is_grid<G>::value>>
+auto to_expression(G const &grid) {
+    using value_type = std::remove_const_t<std::remove_pointer_t<decltype(grid.begin())>>;
+    return Terminal<value_type>(grid.begin(), grid.end() - grid.begin());
+}
+
+template <typename Op, typename L, typename R>
+auto make_binary(L const &lhs, R const &rhs) {
+    using LE = decltype(to_expression(lhs));
+    using RE = decltype(to_expression(rhs));
+    return Binary<Op, LE, RE>(to_expression(lhs), to_expression(rhs));
+}
+
+template <typename Op, typename A>
+auto make_unary(A const &arg) {
+    return Unary<Op, decltype(to_expression(arg))>(to_expression(arg));
+}
+
+template <typename L, typename R, typename = std::enable_if_t<is_binary_operand<L, R>>>
+auto operator +(L const &lhs, R const &rhs) { return make_binary<Add>(lhs, rhs); }
+
+template <typename L, typename R, typename = std::enable_if_t<is_binary_operand<L, R>>>
+auto operator -(L const &lhs, R const &rhs) { return make_binary<Sub>(lhs, rhs); }
+
+template <typename L, typename R, typename = std::enable_if_t<is_binary_operand<L, R>>>
+auto operator *(L const &lhs, R const &rhs) { return make_binary<Mul>(lhs, rhs); }
+
+template <typename L, typename R, typename = std::enable_if_t<is_binary_operand<L, R>>>
+auto operator /(L const &lhs, R const &rhs) { return make_binary<Div>(lhs, rhs); }
+
+template <typename A, typename = std::enable_if_t<is_grid<A>::value || is_expression<A>::value>>
+auto operator -(A const &arg) { return make_unary<Neg>(arg); }
+
+template <typename A, typename = std::enable_if_t<is_grid<A>::value || is_expression<A>::value>>
+auto sqrt(A const &arg) { return make_unary<Sqrt>(arg); }
+
+template <typename A, typename = std::enable_if_t<is_grid<A>::value || is_expression<A>::value>>
+auto abs(A const &arg) { return make_unary<Abs>(arg); }
+
+template <typename A, typename = std::enable_if_t<is_grid<A>::value || is_expression<A>::value>>
+auto exp(A const &arg) { return make_unary<Exp>(arg); }
+
+/**
+ * Evaluates the expression into count elements of dst in one pass.
+ * With several threads the work is split between threads by whole rows of row_size elements.
+ *
+ * @param dst destination buffer.
+ * @param expression expression to evaluate, must have size count or 0.
+ * @param count number of elements.
+ * @param row_size number of elements in the innermost dimension.
+ * @param threads number of threads.
+*/
+template <typename T, typename E>
+void evaluate(T* dst, Expression<E> const &expression, std::size_t count, std::size_t row_size, unsigned threads = 1) {
+    E const &e = expression.self();
+    assert(!e.size() || e.size() == count);
+
+    auto run = [dst, &e](std::size_t begin, std::size_t end) {
+        for (std::size_t idx = begin; idx < end; idx++)
+            dst[idx] = e[idx];
+    };
+
+    std::size_t rows = row_size ? count / row_size : 0;
+    if (threads < 2 || rows < 2) {
+        run(0, count);
+        return;
+    }
+
+    if (threads > rows)
+        threads = rows;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        std::size_t begin = rows * t / threads * row_size;
+        std::size_t end = t + 1 == threads ? count : rows * (t + 1) / threads * row_size;
+        workers.emplace_back(run, begin, end);
+    }
+    for (auto &worker : workers)
+        worker.join();
+}
+
+template <typename X, typename = std::enable_if_t<is_grid<X>::value || is_expression<X>::value>>
+auto sum(X const &x) {
+    auto e = to_expression(x);
+    typename decltype(e)::value_type acc{};
+    for (std::size_t idx = 0; idx < e.size(); idx++)
+        acc += e[idx];
+    return acc;
+}
+
+template <typename X, typename = std::enable_if_t<is_grid<X>::value || is_expression<X>::value>>
+auto max(X const &x) {
+    auto e = to_expression(x);
+    assert(e.size() > 0);
+    auto acc = e[0];
+    for (std::size_t idx = 1; idx < e.size(); idx++)
+        acc = e[idx] > acc ? e[idx] : acc;
+    return acc;
+}
+
+template <typename X, typename = std::enable_if_t<is_grid<X>::value || is_expression<X>::value>>
+auto min(X const &x) {
+    auto e = to_expression(x);
+    assert(e.size() > 0);
+    auto acc = e[0];
+    for (std::size_t idx = 1; idx < e.size(); idx++)
+        acc = e[idx] < acc ? e[idx] : acc;
+    return acc;
+}
+
+#endif
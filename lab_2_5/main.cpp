@@ -1,76 +1,269 @@
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <algorithm>
+#include <new>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "expression.hpp"
 
-template <typename T> 
+// Layout policies map element (y, x) to its offset in grid storage. tile is the block size for blocked traversals,
+// linear layouts keep rows contiguous and without padding.
+struct RowMajor {
+    static constexpr unsigned tile = 16;
+    static constexpr bool linear = true;
+
+    std::size_t const y_size, x_size;
+
+    RowMajor(unsigned y_size, unsigned x_size): y_size(y_size), x_size(x_size) {}
+
+    std::size_t capacity() const { return y_size * x_size; }
+    std::size_t operator ()(unsigned y, unsigned x) const { return y * x_size + x; }
+};
+
+// Square tiles of tile x tile elements stored one after another, tiles and elements inside them go row by row.
+template <unsigned size>
+struct Tiled {
+    static_assert(size && !(size & (size - 1)), "tile size must be a power of two");
+    static constexpr unsigned tile = size;
+    static constexpr bool linear = false;
+
+    std::size_t const y_tiles, x_tiles;
+
+    Tiled(unsigned y_size, unsigned x_size): y_tiles((y_size + size - 1) / size), x_tiles((x_size + size - 1) / size) {}
+
+    std::size_t capacity() const { return y_tiles * x_tiles * size * size; }
+    std::size_t operator ()(unsigned y, unsigned x) const {
+        return ((y / size) * x_tiles + x / size) * size * size + (y % size) * size + x % size;
+    }
+};
+
+// Rectangular Z-order curve: each axis is padded to its own power of two, the low bits the axes share are
+// interleaved and the remaining high bits of the longer axis go above them. Every aligned power of two block up to
+// the shorter side is contiguous, and a thin grid takes no more than twice its size in each axis.
+struct Morton {
+    static constexpr unsigned tile = 16;
+    static constexpr bool linear = false;
+
+    std::size_t y_side, x_side;
+    unsigned shared;    // number of interleaved bits of each coordinate
+    std::uint32_t mask;
+
+    Morton(unsigned y_size, unsigned x_size): y_side(1), x_side(1), shared(0) {
+        while (y_side < y_size)
+            y_side *= 2;
+        while (x_side < x_size)
+            x_side *= 2;
+        while ((std::size_t(1) << (shared + 1)) <= std::min(y_side, x_side))
+            shared++;
+        mask = (std::uint32_t)((std::uint64_t(1) << shared) - 1);
+    }
+
+    static std::uint64_t spread(std::uint32_t value) {
+        std::uint64_t x = value;
+        x = (x | x << 16) & 0x0000FFFF0000FFFFull;
+        x = (x | x << 8) & 0x00FF00FF00FF00FFull;
+        x = (x | x << 4) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | x << 2) & 0x3333333333333333ull;
+        x = (x | x << 1) & 0x5555555555555555ull;
+        return x;
+    }
+
+    std::size_t capacity() const { return y_side * x_side; }
+    std::size_t operator ()(unsigned y, unsigned x) const {
+        // only the longer axis has bits above the shared ones
+        std::uint64_t high = (std::uint64_t)((y | x) >> shared) << 2 * shared;
+        return spread(x & mask) | spread(y & mask) << 1 | high;
+    }
+};
+
+// Non-owning view of one grid row.
+template <typename T, typename Layout = RowMajor>
+class RowView final {
+private:
+    T* data;
+    Layout const &layout;
+    unsigned const y_idx, x_size;
+
+public:
+    RowView(T* data, Layout const &layout, unsigned y_idx, unsigned x_size): data(data), layout(layout), y_idx(y_idx), x_size(x_size) {}
+
+    T& operator [](unsigned idx) const {
+        return data[layout(y_idx, idx)];
+    }
+
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T* begin() const { return data + layout(y_idx, 0); }
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T* end() const { return data + layout(y_idx, 0) + x_size; }
+    unsigned size() const { return x_size; }
+};
+
+template <typename T, typename Layout = RowMajor> 
 class Grid final { 
 public :
     using value_type = T;
     using size_type = unsigned; 
 
 private :
-    T ** data ;
+    static constexpr std::size_t alignment = 64;
+
+    T* data;
     size_type const y_size , x_size ;
-    
+    Layout const layout;
+
+    std::size_t volume() const {
+        return layout.capacity();
+    }
+
 public:
+    // Elements live in one cache-line aligned buffer, element (y, x) is data[layout(y, x)].
     Grid(size_type y_size , size_type x_size, T const &val): 
-        y_size(y_size), x_size(x_size) {
-        data = new T*[y_size];
-        for (size_type i = 0; i < y_size; i++){
-            data[i] = new T[x_size];
-            for (size_type j = 0; j < x_size; j++)
-                data[i][j] = val;
-        }
+        y_size(y_size), x_size(x_size), layout(y_size, x_size) {
+        data = static_cast<T*>(::operator new[](volume() * sizeof(T), std::align_val_t(alignment)));
+        std::uninitialized_fill_n(data, volume(), val);
     }
 
-    Grid(T const &t){
-        Grid(1, 1, t);
-    }
+    Grid(T const &t): Grid(1, 1, t) {}
 
-    Grid(size_type y_size , size_type x_size){
-        Grid(y_size, x_size, T());
-    }
+    Grid(size_type y_size , size_type x_size): Grid(y_size, x_size, T()) {}
 
-    Grid(Grid<T> const &) = delete; 
-    Grid(Grid<T>&&)= delete;
-    Grid<T>& operator=(Grid<T>&) = delete ;
-    Grid<T>& operator=(Grid<T>&&) = delete ;
+    Grid(Grid const &) = delete; 
+    Grid(Grid&&)= delete;
+    Grid& operator=(Grid&) = delete ;
+    Grid& operator=(Grid&&) = delete ;
 
     T operator ()( size_type y_idx , size_type x_idx) const { 
-        return data[y_idx][x_idx] ;
+        return data[layout(y_idx, x_idx)] ;
     }
 
     T& operator ()( size_type y_idx , size_type x_idx) { 
-        return data[y_idx][x_idx] ;
+        return data[layout(y_idx, x_idx)] ;
+    }
+
+    Grid& operator=(T const &t) {
+        std::fill_n(data, volume(), t);
+        return *this ;
     }
 
-    Grid<T>& operator=(T const &t) {
-        for (auto it = data, end = data + x_size * y_size; it != end; ++it)
-            *it=t; 
+    // Copies rows from a buffer of y_size * x_size elements in row-major order.
+    Grid& assign(T const *src) {
+        if (Layout::linear) {
+            std::copy_n(src, volume(), data);
+            return *this ;
+        }
+        for (size_type y_idx = 0; y_idx < y_size; y_idx++)
+            for (size_type x_idx = 0; x_idx < x_size; x_idx++)
+                data[layout(y_idx, x_idx)] = *src++;
         return *this ;
     }
 
-    Grid<T>& operator=(T &&t) {
-        // for (auto it = data, end = data + x_size * y_size; it != end; ++it)
-        //     *it=t; 
-        // return *this ;
-        return Grid(std::move(t));
+    // Evaluates element-wise expression of grids of the same size in one pass, rows are split between threads.
+    template <typename E>
+    Grid& assign(Expression<E> const &expression, unsigned threads = 1) {
+        static_assert(Layout::linear, "expressions are evaluated over linear layouts only");
+        evaluate(data, expression, volume(), x_size, threads);
+        return *this ;
+    }
+
+    template <typename E>
+    Grid& operator=(Expression<E> const &expression) {
+        return assign(expression);
+    }
+
+    RowView<T, Layout> operator [](size_type idx){
+        return RowView<T, Layout>(data, layout, idx, x_size);
     }
 
-    T* operator [](size_type idx){
-        return data[idx];
+    RowView<T const, Layout> operator [](size_type idx) const {
+        return RowView<T const, Layout>(data, layout, idx, x_size);
     }
 
+    /**
+     * Calls f(y_begin, y_end, x_begin, x_end) for every block of Layout::tile x Layout::tile elements,
+     * so kernels can process the grid one cache-resident tile at a time.
+     */
+    template <typename F>
+    void for_each_tile(F f) const {
+        for (size_type y_idx = 0; y_idx < y_size; y_idx += Layout::tile)
+            for (size_type x_idx = 0; x_idx < x_size; x_idx += Layout::tile)
+                f(y_idx, std::min(y_idx + Layout::tile, y_size), x_idx, std::min(x_idx + Layout::tile, x_size));
+    }
+
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T* begin() { return data; }
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T* end() { return data + volume(); }
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T const* begin() const { return data; }
+    template <typename L = Layout, typename = std::enable_if_t<L::linear>>
+    T const* end() const { return data + volume(); }
+
     size_type get_y_size () const { return y_size ; }
     size_type get_x_size () const { return x_size ; }
 
     ~Grid(){
-        for (size_type idx = 0; idx < y_size; idx++)
-            delete data[idx];
-        delete [] data;
+        std::destroy_n(data, volume());
+        ::operator delete[](data, std::align_val_t(alignment));
     } 
 };
 
-int main() {
+// Only linear layouts expose begin() and end(), so only they take part in expressions.
+template <typename T, typename Layout>
+struct is_grid<Grid<T, Layout>>: std::integral_constant<bool, Layout::linear> {};
+
+template <typename Layout>
+void stencil(Grid<float, Layout> const &src, Grid<float, Layout> &dst) {
+    unsigned const y_size = src.get_y_size(), x_size = src.get_x_size();
+    src.for_each_tile([&](unsigned y_begin, unsigned y_end, unsigned x_begin, unsigned x_end) {
+        for (unsigned y = std::max(y_begin, 1u); y < std::min(y_end, y_size - 1); y++)
+            for (unsigned x = std::max(x_begin, 1u); x < std::min(x_end, x_size - 1); x++)
+                dst(y, x) = 0.25f * (src(y - 1, x) + src(y + 1, x) + src(y, x - 1) + src(y, x + 1));
+    });
+}
+
+template <typename Layout>
+void transpose(Grid<float, Layout> const &src, Grid<float, Layout> &dst) {
+    src.for_each_tile([&](unsigned y_begin, unsigned y_end, unsigned x_begin, unsigned x_end) {
+        for (unsigned y = y_begin; y < y_end; y++)
+            for (unsigned x = x_begin; x < x_end; x++)
+                dst(x, y) = src(y, x);
+    });
+}
+
+template <typename Layout>
+void benchmark_layout(char const *name, unsigned size) {
+    Grid<float, Layout> src(size, size, 1.0f), dst(size, size, 0.0f);
+    for (unsigned y = 0; y < size; y++)
+        for (unsigned x = 0; x < size; x++)
+            src(y, x) = (float)(y ^ x);
+
+    auto measure = [](auto kernel) {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    double stencil_time = measure([&] { stencil(src, dst); });
+    double transpose_time = measure([&] { transpose(src, dst); });
+    std::cout << name << ": stencil " << stencil_time << " ms, transpose " << transpose_time << " ms\n";
+}
+
+void benchmark_layouts(unsigned size) {
+    Grid<float> src(size, size, 1.0f), dst(size, size, 0.0f);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned y = 0; y < size; y++)
+        for (unsigned x = 0; x < size; x++)
+            dst(x, y) = src(y, x);
+    std::cout << "row-major, row by row: transpose " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+
+    benchmark_layout<RowMajor>("row-major", size);
+    benchmark_layout<Tiled<16>>("tiled 16x16", size);
+    benchmark_layout<Morton>("morton", size);
+}
+
+int main(int argc, char** argv) {
     Grid<float> g(3, 2, 0.0f); 
 
     // g[0][1] = 10;
@@ -90,5 +283,30 @@ int main() {
     for (gsize_t y_idx = 0; y_idx != g.get_y_size(); ++y_idx)
         for (gsize_t x_idx = 0; x_idx != g.get_x_size(); ++x_idx)
             assert (1.0f == g(y_idx , x_idx )); 
+
+    g = 2.0f;
+    for (float val : g)
+        assert(2.0f == val);
+    Grid<float> const &cg = g;
+    assert(2.0f == cg[2][1]);
+
+    Grid<float> h(3, 2, 9.0f);
+    g = g + sqrt(h) * 2.0f;
+    assert(8.0f == g(1, 1));
+    g.assign(g - 1.0f, 2);
+    assert(7.0f == max(g) && 42.0f == sum(g));
+
+    Grid<int, Tiled<8>> tiled(10, 20, 0);
+    Grid<int, Morton> morton(10, 20, 0);
+    for (gsize_t y_idx = 0; y_idx != 10; ++y_idx)
+        for (gsize_t x_idx = 0; x_idx != 20; ++x_idx)
+            tiled[y_idx][x_idx] = morton(y_idx, x_idx) = y_idx * 20 + x_idx;
+    for (gsize_t y_idx = 0; y_idx != 10; ++y_idx)
+        for (gsize_t x_idx = 0; x_idx != 20; ++x_idx)
+            assert(tiled(y_idx, x_idx) == (int)(y_idx * 20 + x_idx) && morton[y_idx][x_idx] == tiled(y_idx, x_idx));
+
+    // the benchmark works on 4096 x 4096 grids, so it runs only with --benchmark
+    if (argc > 1 && !strcmp(argv[1], "--benchmark"))
+        benchmark_layouts(4096);
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,109 @@
 #include <iostream>
 #include <cassert>
 #include <stdarg.h>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "expression.hpp"
+
+template <typename T, unsigned dim>
+class Grid;
+
+// Non-owning view of a dim-dimensional block of grid elements. Element (i0, ..., in) is data[i0 * stride[0] + ... + in * stride[n]],
+// so slices and strided sub-ranges only change the pointer, sizes and strides.
+template <typename T, unsigned dim>
+class GridView final {
+public :
+    using value_type = T;
+    using size_type = unsigned;
+
+private :
+    T* data;
+    size_type size[dim];
+    std::ptrdiff_t stride[dim];
+
+    std::ptrdiff_t get_offset(unsigned) const {
+        return 0;
+    }
+
+    template <typename ... Args>
+    std::ptrdiff_t get_offset(unsigned i, size_type idx, Args ... args) const {
+        return idx * stride[i] + get_offset(i + 1, args...);
+    }
+
+    void copy_to(std::remove_const_t<T>*& out, T* base, unsigned axis) const {
+        for (size_type i = 0; i < size[axis]; i++) {
+            if (axis + 1 == dim)
+                *out++ = base[i * stride[axis]];
+            else
+                copy_to(out, base + i * stride[axis], axis + 1);
+        }
+    }
+
+public:
+    GridView(T* data, size_type const* sizes, std::ptrdiff_t const* strides): data(data) {
+        for (unsigned i = 0; i < dim; i++) {
+            size[i] = sizes[i];
+            stride[i] = strides[i];
+        }
+    }
+
+    template <typename ... Args>
+    T& operator ()(Args ... args) const {
+        static_assert(sizeof...(Args) == dim, "number of indices must be equal to dimension");
+        return data[get_offset(0, args...)];
+    }
+
+    decltype(auto) operator [](size_type idx) const {
+        if constexpr (dim == 1)
+            return data[idx * stride[0]];
+        else
+            return GridView<T, dim - 1>(data + idx * stride[0], size + 1, stride + 1);
+    }
+
+    /**
+     * Returns view of indices begin, begin + step, ... below end along the axis. end is clamped to the axis size.
+     *
+     * @throws std::out_of_range if axis is not below dim or begin is past the axis size.
+     * @throws std::invalid_argument if step is zero.
+     */
+    GridView<T, dim> slice(unsigned axis, size_type begin, size_type end, size_type step = 1) const {
+        if (axis >= dim || begin > size[axis])
+            throw std::out_of_range("Slice is out of the grid.");
+        if (!step)
+            throw std::invalid_argument("Slice step cannot be zero.");
+        end = std::min(end, size[axis]);
+
+        GridView<T, dim> view(*this);
+        view.data += begin * stride[axis];
+        view.size[axis] = end > begin ? (end - begin + step - 1) / step : 0;
+        view.stride[axis] *= step;
+        return view;
+    }
+
+    size_type get_size(unsigned axis) const {
+        return size[axis];
+    }
+
+    /**
+     * Copies viewed elements to a new owning grid.
+     */
+    Grid<std::remove_const_t<T>, dim> copy() const;
+};
 
 template <typename T, unsigned dim> 
 class Grid final { 
@@ -11,6 +114,7 @@ public :
 private :
     value_type* data;
     size_type* size;
+    std::ptrdiff_t stride[dim];
 
     size_type get_vol(size_type n) const{
         size_type vol = 1;
@@ -19,11 +123,27 @@ private :
         return vol;
     }
 
+    void update_strides(){
+        std::ptrdiff_t vol = 1;
+        for (size_type i = dim; i > 0; i--){
+            stride[i - 1] = vol;
+            vol *= size[i - 1];
+        }
+    }
+
     void init(value_type val){
-        for (size_type i = 0; i < get_vol(dim); i++)
+        update_strides();
+        size_type vol = get_vol(dim);
+        data = new value_type[vol];
+        for (size_type i = 0; i < vol; i++)
             data[i] = val;
     }
 
+    template <std::size_t ... I, typename ... Args>
+    std::ptrdiff_t get_idx(std::index_sequence<I...>, Args ... args) const{
+        return ((args * stride[I]) + ... + 0);
+    }
+
     void construct(size_type i, value_type val){
         init(val);
     }
@@ -38,13 +158,13 @@ public:
     template <typename ... Args>
     Grid(Args ... args) {
         size = new size_type[dim];
-        data = new value_type[get_vol(dim)];
         construct(0, args...);
     }
 
     Grid(size_type* sizes, value_type* vals) {
         size = sizes;
         data = vals;
+        update_strides();
     }
 
     Grid(Grid<value_type, dim> const &) = delete; 
@@ -52,54 +172,74 @@ public:
     // Grid<value_type, dim>& operator=(Grid<value_type, dim>&) = delete ;
     // Grid<value_type, dim>& operator=(Grid<value_type, dim>&&) = delete ;
     
-    Grid<value_type, dim> operator=(Grid<value_type, dim>&& grid) {
-        delete [] data;
-        for (size_type idx = 0; idx < dim; idx++)
-            size[idx] = grid.size[idx];
-        
-        size_type vol = get_vol(dim);
-        data = new value_type [vol];
-        for (size_type idx = 0; idx < vol; idx++)
-            data[idx] = grid.data[idx];
+    Grid<value_type, dim>& operator=(Grid<value_type, dim>&& grid) {
+        std::swap(data, grid.data);
+        std::swap(size, grid.size);
+        update_strides();
+        grid.update_strides();
+        return *this;
     }
 
-    Grid<value_type, dim> operator=(Grid<value_type, dim>& grid){
+    Grid<value_type, dim>& operator=(Grid<value_type, dim>& grid){
         delete [] data;
         for (size_type idx = 0; idx < dim; idx++)
             size[idx] = grid.size[idx];
+        update_strides();
         
         size_type vol = get_vol(dim);
         data = new value_type [vol];
         for (size_type idx = 0; idx < vol; idx++)
             data[idx] = grid.data[idx];
+        return *this;
     }
 
-    size_type get_idx(size_type i, size_type sizex) const{
-        return sizex;
+    template <typename U>
+    Grid<value_type, dim>& operator=(GridView<U, dim> const &view) {
+        return *this = view.copy();
     }
 
     template <typename ... Args>
-    size_type get_idx(size_type i, size_type sizex, Args ... args) const{
-        return sizex * get_vol(dim - i) + get_idx(++i, args...);
+    value_type operator ()(Args ... args) const{
+        static_assert(sizeof...(Args) == dim, "number of indices must be equal to dimension");
+        return data[get_idx(std::index_sequence_for<Args...>{}, args...)] ;
     }
 
     template <typename ... Args>
-    value_type operator ()(Args ... args) const{
-        return data[get_idx(1, args...)] ;
+    value_type& operator ()(Args ... args) {
+        static_assert(sizeof...(Args) == dim, "number of indices must be equal to dimension");
+        return data[get_idx(std::index_sequence_for<Args...>{}, args...)] ;
+    }
+
+    template <typename E>
+    Grid<value_type, dim>& assign(Expression<E> const &expression, unsigned threads = 1) {
+        evaluate(data, expression, get_vol(dim), size[dim - 1], threads);
+        return *this;
     }
 
-    // Grid<value_type, dim - 1> operator [](size_type idx) const{
-    auto operator [](size_type idx) const {
-        auto sizes = new size_type [dim - 1];
-        for (size_type i = 0; i < dim - 1; i++)
-            sizes[i] = size[i+1];
-        size_type vol = get_vol(dim - 1);
+    template <typename E>
+    Grid<value_type, dim>& operator=(Expression<E> const &expression) {
+        return assign(expression);
+    }
 
-        auto vals = new value_type [vol];
-        for (size_type i = 0; i < vol; i++)
-            vals[i] = data[idx * vol + i];
+    value_type* begin() { return data; }
+    value_type* end() { return data + get_vol(dim); }
+    value_type const* begin() const { return data; }
+    value_type const* end() const { return data + get_vol(dim); }
+
+    GridView<value_type, dim> view() {
+        return GridView<value_type, dim>(data, size, stride);
+    }
+
+    GridView<value_type const, dim> view() const {
+        return GridView<value_type const, dim>(data, size, stride);
+    }
+
+    decltype(auto) operator [](size_type idx) {
+        return view()[idx];
+    }
 
-        return Grid<value_type, dim - 1>(sizes, vals);
+    decltype(auto) operator [](size_type idx) const {
+        return view()[idx];
     }
 
     ~Grid(){
@@ -108,6 +248,279 @@ public:
     } 
 };
 
+template <typename T, unsigned dim>
+struct is_grid<Grid<T, dim>>: std::true_type {};
+
+// Grid with extents known at compile time, so all strides and the volume are constants.
+template <typename T, unsigned ... Extents>
+class StaticGrid final {
+public :
+    using value_type = T;
+    using size_type = unsigned;
+    static constexpr unsigned dim = sizeof...(Extents);
+    static constexpr size_type volume = (Extents * ... * 1);
+
+private :
+    static constexpr size_type size[dim] = {Extents...};
+
+    static constexpr std::array<std::ptrdiff_t, dim> make_strides(){
+        std::array<std::ptrdiff_t, dim> strides{};
+        std::ptrdiff_t vol = 1;
+        for (unsigned i = dim; i > 0; i--){
+            strides[i - 1] = vol;
+            vol *= size[i - 1];
+        }
+        return strides;
+    }
+
+    static constexpr std::array<std::ptrdiff_t, dim> stride = make_strides();
+
+    value_type* data;
+
+    template <std::size_t ... I, typename ... Args>
+    static constexpr std::ptrdiff_t get_idx(std::index_sequence<I...>, Args ... args){
+        return ((args * stride[I]) + ... + 0);
+    }
+
+public:
+    explicit StaticGrid(value_type const &val = value_type()): data(new value_type[volume]) {
+        for (size_type i = 0; i < volume; i++)
+            data[i] = val;
+    }
+
+    StaticGrid(StaticGrid const &) = delete;
+    StaticGrid& operator=(StaticGrid const &) = delete;
+
+    template <typename ... Args>
+    value_type operator ()(Args ... args) const{
+        static_assert(sizeof...(Args) == dim, "number of indices must be equal to dimension");
+        return data[get_idx(std::index_sequence_for<Args...>{}, args...)] ;
+    }
+
+    template <typename ... Args>
+    value_type& operator ()(Args ... args) {
+        static_assert(sizeof...(Args) == dim, "number of indices must be equal to dimension");
+        return data[get_idx(std::index_sequence_for<Args...>{}, args...)] ;
+    }
+
+    GridView<value_type, dim> view() {
+        return GridView<value_type, dim>(data, size, stride.data());
+    }
+
+    GridView<value_type const, dim> view() const {
+        return GridView<value_type const, dim>(data, size, stride.data());
+    }
+
+    decltype(auto) operator [](size_type idx) {
+        return view()[idx];
+    }
+
+    decltype(auto) operator [](size_type idx) const {
+        return view()[idx];
+    }
+
+    static constexpr size_type get_size(unsigned axis) {
+        return size[axis];
+    }
+
+    ~StaticGrid(){
+        delete [] data;
+    }
+};
+
+template <typename T, unsigned dim>
+Grid<std::remove_const_t<T>, dim> GridView<T, dim>::copy() const {
+    using value_type = std::remove_const_t<T>;
+    auto sizes = new size_type[dim];
+    size_type vol = 1;
+    for (unsigned i = 0; i < dim; i++)
+        vol *= sizes[i] = size[i];
+
+    auto vals = new value_type[vol];
+    value_type* out = vals;
+    if (vol)
+        copy_to(out, data, 0);
+    return Grid<value_type, dim>(sizes, vals);
+}
+
+// Binary grid file: this header, then raw row-major elements starting at data_offset (4096 aligned).
+struct GridFileHeader {
+    static constexpr unsigned max_dim = 8;
+    static constexpr std::uint64_t page = 4096;
+
+    char magic[8];
+    char kind;
+    std::uint8_t element_size;
+    std::uint16_t dim;
+    std::uint32_t reserved;
+    std::uint64_t data_offset;
+    std::uint64_t sizes[max_dim];
+};
+
+template <typename T>
+constexpr char grid_kind() {
+    static_assert(std::is_arithmetic<T>::value, "only arithmetic elements can be stored in grid files");
+    return std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : 'u';
+}
+
+template <typename T, unsigned dim>
+void save(Grid<T, dim> const &grid, char const *path) {
+    static_assert(dim <= GridFileHeader::max_dim, "too many dimensions for grid file");
+    GridFileHeader header{};
+    memcpy(header.magic, "GRIDBIN", 8);
+    header.kind = grid_kind<T>();
+    header.element_size = sizeof(T);
+    header.dim = dim;
+    header.data_offset = GridFileHeader::page;
+    auto view = grid.view();
+    for (unsigned i = 0; i < dim; i++)
+        header.sizes[i] = view.get_size(i);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(std::string("Cannot create grid file ") + path);
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.seekp(header.data_offset);
+    file.write(reinterpret_cast<char const*>(grid.begin()), (grid.end() - grid.begin()) * sizeof(T));
+    if (!file)
+        throw std::runtime_error(std::string("Cannot write grid file ") + path);
+}
+
+enum class MapMode { ReadOnly, CopyOnWrite };
+enum class Access { Normal, Sequential, Random, WillNeed };
+
+/**
+ * Grid backed by a memory-mapped grid file. Opening only maps the file, pages are read by the system when elements
+ * are touched, so views and slices fault in only the pages they actually access.
+ * ReadOnly maps file pages shared and read-only, CopyOnWrite allows writes to private copies of pages that never reach the file.
+ */
+template <typename T, unsigned dim>
+class MappedGrid final {
+public :
+    using value_type = T;
+    using size_type = unsigned;
+
+private :
+    void* mapping = MAP_FAILED;
+    std::size_t length = 0;
+    MapMode const mode;
+    T* data;
+    size_type size[dim];
+    std::ptrdiff_t stride[dim];
+
+    static int advice(Access access) {
+        switch (access) {
+            case Access::Sequential: return MADV_SEQUENTIAL;
+            case Access::Random: return MADV_RANDOM;
+            case Access::WillNeed: return MADV_WILLNEED;
+            default: return MADV_NORMAL;
+        }
+    }
+
+    void fail(std::string const &message) {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, length);
+        throw std::runtime_error(message);
+    }
+
+public:
+    explicit MappedGrid(char const *path, MapMode mode = MapMode::ReadOnly): mode(mode) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error(std::string("Cannot open grid file ") + path + ": " + strerror(errno));
+        struct stat info;
+        if (fstat(fd, &info) < 0 || (std::size_t)info.st_size < sizeof(GridFileHeader)) {
+            close(fd);
+            throw std::runtime_error(std::string("Invalid grid file ") + path);
+        }
+
+        length = info.st_size;
+        if (mode == MapMode::ReadOnly)
+            mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        else
+            mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(std::string("Cannot map grid file ") + path + ": " + strerror(errno));
+
+        auto header = static_cast<GridFileHeader const*>(mapping);
+        if (memcmp(header->magic, "GRIDBIN", 8) || header->kind != grid_kind<T>() || header->element_size != sizeof(T) || header->dim != dim)
+            fail(std::string("Grid file ") + path + " does not match grid type");
+
+        // sizes come from the file, so every product and sum is checked before it is compared to the file length
+        std::uint64_t const max = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t vol = 1;
+        for (unsigned i = 0; i < dim; i++) {
+            std::uint64_t const axis_size = header->sizes[i];
+            if (axis_size > std::numeric_limits<size_type>::max() || (axis_size && vol > max / axis_size))
+                fail(std::string("Grid file ") + path + " has invalid sizes");
+            size[i] = axis_size;
+            vol *= axis_size;
+        }
+        std::uint64_t const offset = header->data_offset;
+        if (offset % alignof(T) || offset > length || vol > (length - offset) / sizeof(T))
+            fail(std::string("Grid file ") + path + " is truncated");
+
+        data = reinterpret_cast<T*>(static_cast<char*>(mapping) + header->data_offset);
+        std::ptrdiff_t step = 1;
+        for (unsigned i = dim; i > 0; i--) {
+            stride[i - 1] = step;
+            step *= size[i - 1];
+        }
+    }
+
+    MappedGrid(MappedGrid const &) = delete;
+    MappedGrid& operator=(MappedGrid const &) = delete;
+
+    GridView<value_type const, dim> view() const {
+        return GridView<value_type const, dim>(data, size, stride);
+    }
+
+    /**
+     * Writable view, available only for CopyOnWrite mappings.
+     *
+     * @throws std::logic_error if the grid is mapped read-only.
+     */
+    GridView<value_type, dim> mutable_view() {
+        if (mode == MapMode::ReadOnly)
+            throw std::logic_error("Read-only grid cannot be modified.");
+        return GridView<value_type, dim>(data, size, stride);
+    }
+
+    template <typename ... Args>
+    value_type operator ()(Args ... args) const {
+        return view()(args...);
+    }
+
+    decltype(auto) operator [](size_type idx) const {
+        return view()[idx];
+    }
+
+    size_type get_size(unsigned axis) const {
+        return size[axis];
+    }
+
+    /**
+     * Tells the system how the whole grid or outer indices [begin, end) will be accessed.
+     */
+    void advise(Access access) const {
+        if (madvise(mapping, length, advice(access)) < 0)
+            throw std::runtime_error(std::string("Cannot advise grid mapping: ") + strerror(errno));
+    }
+
+    void advise(Access access, size_type begin, size_type end) const {
+        // madvise needs an address aligned to the system page, which is 16K or 64K on some systems
+        static std::uintptr_t const page = sysconf(_SC_PAGESIZE);
+        auto first = reinterpret_cast<std::uintptr_t>(data + begin * stride[0]) & ~(page - 1);
+        auto last = reinterpret_cast<std::uintptr_t>(data + end * stride[0]);
+        if (last > first && madvise(reinterpret_cast<void*>(first), last - first, advice(access)) < 0)
+            throw std::runtime_error(std::string("Cannot advise grid mapping: ") + strerror(errno));
+    }
+
+    ~MappedGrid() {
+        munmap(mapping, length);
+    }
+};
 
 int main() {
     Grid<float, 3> const g3(2, 3, 4, 1.0f);
@@ -117,5 +530,39 @@ int main() {
     Grid<float, 2> g21(2, 5, 3.0f);
     g2 = g3[1];
     assert(1.0f == g2(1, 1));
+
+    Grid<int, 3> g(2, 3, 4, 0);
+    for (unsigned i = 0; i < 2; i++)
+        for (unsigned j = 0; j < 3; j++)
+            for (unsigned k = 0; k < 4; k++)
+                g[i][j][k] = 100 * i + 10 * j + k;
+    assert(123 == g(1, 2, 3));
+    auto odd = g[1].slice(1, 1, 4, 2);
+    assert(2 == odd.get_size(1) && 111 == odd(1, 0) && 123 == odd[2][1]);
+    Grid<int, 2> g12(1, 1, 0);
+    g12 = odd;
+    assert(103 == g12(0, 1));
+
+    StaticGrid<int, 2, 3, 4> sg(0);
+    sg(1, 2, 3) = 123;
+    static_assert(24 == StaticGrid<int, 2, 3, 4>::volume, "volume is known at compile time");
+    assert(123 == sg[1][2][3] && 4 == sg.get_size(2));
+
+    Grid<float, 3> f(2, 3, 4, 4.0f);
+    f = f * f + sqrt(f);
+    assert(18.0f == f(1, 2, 3) && 18.0f * 24 == sum(f));
+
+    save(g, "grid.bin");
+    {
+        MappedGrid<int, 3> mg("grid.bin");
+        mg.advise(Access::Random);
+        assert(123 == mg(1, 2, 3) && 111 == mg[1].slice(1, 1, 4, 2)(1, 0));
+        MappedGrid<int, 3> cow("grid.bin", MapMode::CopyOnWrite);
+        cow.mutable_view()(1, 2, 3) = 0;
+        assert(123 == mg.view()(1, 2, 3));
+        cow.advise(Access::Sequential, 1, 2);
+        assert(0 == cow(1, 2, 3) && 123 == mg(1, 2, 3));
+    }
+    std::remove("grid.bin");
     return 0;
 }
\ No newline at end of file
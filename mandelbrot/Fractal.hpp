@@ -7,6 +7,11 @@
 #define FRACTAL
 
 #include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
 #include <SFML/Graphics.hpp>
 
 
@@ -24,6 +29,11 @@ protected:
 	const int width, height;
     double *iterationsArray = nullptr;
 
+    // Single precision is used only below this zoom and while pixel spacing stays this many times wider than
+    // the float rounding error accumulated over maxIterations iterations.
+    static constexpr double floatZoomLimit = 1e4;
+    static constexpr double floatSpacingMargin = 1;
+
 public:
 	/**
 	 * Main constructor of the class. 
@@ -87,10 +97,36 @@ public:
 	        scale *= k;	
 	}
 
+    /**
+     * Checks if single precision is enough to render the current view without artifacts.
+     * Rounding error grows with every iteration and is amplified near the boundary of the set, so pixel spacing
+     * is compared to float epsilon at the largest coordinate magnitude of the view times maxIterations squared.
+     * The view is promoted to double automatically while zooming in or raising the number of iterations.
+     *
+     * @return true if the view can be iterated with float.
+    */
+    bool isFloatPrecise() const {
+        if (scale / startScale >= floatZoomLimit)
+            return false;
+        double magnitude = fmax(fabs(x0) + width / (2 * scale), fabs(y0) + height / (2 * scale));
+        return 1 / scale > floatSpacingMargin * maxIterations * maxIterations * FLT_EPSILON * fmax(magnitude, 2);
+    }
+
 	/**
 	 * Virtual function that must be overriden for each subclass for correct rendering.
 	*/
     virtual void iterate(int x, int y) = 0;
+
+    /**
+     * Processes the whole row y of the view. By default calls Fractal::iterate for each pixel,
+     * override it to process several pixels at once.
+     *
+     * @param y vertical coordinate of the row.
+    */
+    virtual void iterateRow(int y) {
+        for (int x = 0; x < width; x++)
+            iterate(x, y);
+    }
 	
 	/**
 	 * Destructor of the class. Closes the window and deletes dynamic array of pixels.
@@ -110,6 +146,50 @@ public:
  * Subclass of Fractal class that enures for rendering mandelbrot set.
 */
 class MandelbrotSet final: public Fractal {
+private:
+	/**
+	 * Processes the row y by blocks of pixels that fill 256 bits, so float blocks are twice as wide as double ones.
+	 * Blocks are GCC/Clang vector types, so the loop is vector code on any target: one AVX register with -mavx,
+	 * two SSE registers on the baseline x86-64 or NEON ones on ARM.
+	 * Escaped pixels of the block are frozen by masks and the block stops when all of them have escaped.
+	 *
+	 * @param y vertical coordinate of the row.
+	*/
+	template <typename Real, typename Int>
+	void iterateLanes(int y) {
+		static_assert(sizeof(Real) == sizeof(Int), "mask lanes must be as wide as value lanes");
+		typedef Real Block __attribute__((vector_size(32)));
+		typedef Int Mask __attribute__((vector_size(32)));
+		constexpr int lanes = 32 / sizeof(Real);
+		const Real ci = (Real)((y - height/2) / scale - y0);
+
+		for (int x = 0; x < width; x += lanes) {
+			Block cr, xc = {}, yc = {};
+			Mask iterations = {};
+			for (int l = 0; l < lanes; l++)
+				cr[l] = (Real)((x + l - width/2) / scale - x0);
+
+			for (unsigned i = 0; i <= maxIterations; i++) {
+				Block xx = xc * xc - yc * yc + cr;
+				Block yy = 2 * xc * yc + ci;
+				// all ones in lanes that have not escaped yet
+				Mask inside = (Mask)(xc * xc + yc * yc < 4);
+				xc = (Block)(((Mask)xx & inside) | ((Mask)xc & ~inside));
+				yc = (Block)(((Mask)yy & inside) | ((Mask)yc & ~inside));
+				iterations -= inside;
+
+				Int active = 0;
+				for (int l = 0; l < lanes; l++)
+					active |= inside[l];
+				if (!active)
+					break;
+			}
+
+			for (int l = 0; l < lanes && x + l < width; l++)
+				iterationsArray[width * y + x + l] = (double)(iterations[l] - 1) / (double)maxIterations;
+		}
+	}
+
 public:
 	/**
 	 * Overriden method that processes point (x, y) of the set and updates information about its iterations number. 
@@ -131,6 +211,36 @@ public:
         iterationsArray[width * y + x] = (double)(iterations - 1) / (double)maxIterations;
     }
 
+	/**
+	 * Overriden method that processes the whole row y. Uses float kernel for shallow views and double one otherwise.
+	*/
+	void iterateRow(int y) override {
+		if (isFloatPrecise())
+			iterateLanes<float, int32_t>(y);
+		else
+			iterateLanes<double, int64_t>(y);
+	}
+
+	/**
+	 * Renders the current view with both float and double kernels and counts pixels whose iteration numbers differ.
+	 * Used by precision_check.cpp to check that views accepted by Fractal::isFloatPrecise look the same in float.
+	 *
+	 * @return number of differing pixels.
+	*/
+	unsigned floatMismatches() {
+		std::vector<double> single(width * height);
+		for (int y = 0; y < height; y++)
+			iterateLanes<float, int32_t>(y);
+		std::copy(iterationsArray, iterationsArray + width * height, single.begin());
+		for (int y = 0; y < height; y++)
+			iterateLanes<double, int64_t>(y);
+
+		unsigned mismatches = 0;
+		for (int idx = 0; idx < width * height; idx++)
+			mismatches += single[idx] != iterationsArray[idx];
+		return mismatches;
+	}
+
 	/**
 	 * Main constructor of the class. 
 	 * 
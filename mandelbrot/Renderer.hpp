@@ -106,9 +106,11 @@ public:
      * Sets all pixels' colors.
     */
     void setPixels() {
-			for (unsigned y = 0; y < height; y++)
+        for (unsigned y = 0; y < height; y++) {
+            fractal->iterateRow(y);
             for (unsigned x = 0; x < width; x++)
-                setPixel(x, y);
+                setColor(x, y, (double) (fractal->getIterationsArray()[width * y + x]));
+        }
     }
 
     /**
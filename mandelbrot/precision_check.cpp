@@ -0,0 +1,42 @@
+/**
+ * @brief File is a part of {{mandelbrot}}. Checks that the float kernel does not change rendered views.
+ *
+ * For several centers and numbers of iterations the view is zoomed in up to the last zoom where
+ * Fractal::isFloatPrecise still chooses float, and iteration numbers of the float and double kernels are compared there.
+ * A few chaotic pixels on the boundary of the set differ in any precision, so up to maxMismatchShare of pixels may differ.
+ *
+ * to execute use g++ -std=c++17 precision_check.cpp -I/opt/local/include/ -O3 && ./a.out
+*/
+
+#include "Fractal.hpp"
+
+const double maxMismatchShare = 5e-4;
+
+int main() {
+	const unsigned width = 1500, height = 1000;
+	const double centers[][2] = {{0, 0}, {0.7436, 0.1318}, {0.5, 0}, {-0.25, 0.65}, {1.25, 0.02}, {0.1, 0.9}};
+	const unsigned iterations[] = {20, 50, 100, 200, 1000};
+
+	int failed = 0;
+	for (auto center : centers)
+		for (unsigned maxIterations : iterations) {
+			MandelbrotSet mandelbrot(width, height, maxIterations, center[0], center[1]);
+			std::cout << '(' << -center[0] << ", " << -center[1] << ") " << maxIterations << " iterations: ";
+			if (!mandelbrot.isFloatPrecise()) {
+				std::cout << "double only\n";
+				continue;
+			}
+
+			// the last zoom before the switch to double
+			double zoom = 1;
+			for (mandelbrot.rescale(2); mandelbrot.isFloatPrecise(); mandelbrot.rescale(2))
+				zoom *= 2;
+			mandelbrot.rescale(0.5);
+
+			unsigned mismatches = mandelbrot.floatMismatches();
+			bool ok = mismatches <= maxMismatchShare * width * height;
+			failed += !ok;
+			std::cout << "float up to zoom " << zoom << ", " << mismatches << " pixels differ" << (ok ? "\n" : " FAILED\n");
+		}
+	return failed ? 1 : 0;
+}